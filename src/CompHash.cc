@@ -6,6 +6,7 @@
 #include <map>
 #include <vector>
 
+#include "zeek/Desc.h"
 #include "zeek/Dict.h"
 #include "zeek/Func.h"
 #include "zeek/Hash.h"
@@ -15,6 +16,8 @@
 #include "zeek/Val.h"
 #include "zeek/ZeekString.h"
 
+#include "zeek/3rdparty/doctest.h"
+
 namespace zeek::detail {
 
 // A comparison callable to assist with consistent iteration order over tables
@@ -58,9 +61,124 @@ static HashkeyMapPtr ordered_hashkeys(const TableVal* tv) {
 CompositeHash::CompositeHash(TypeListPtr composite_type) : type(std::move(composite_type)) {
     if ( type->GetTypes().size() == 1 )
         is_singleton = true;
+    else
+        BuildFixedLayout();
+}
+
+void CompositeHash::BuildFixedLayout() {
+    std::vector<FixedElement> layout;
+    size_t size = 0;
+
+    // This mirrors the reservations made by ReserveSingleTypeKeySize().
+    for ( const auto& t : type->GetTypes() ) {
+        auto it = t->InternalType();
+        size_t elem_size;
+        size_t alignment;
+
+        switch ( it ) {
+            case TYPE_INTERNAL_INT:
+            case TYPE_INTERNAL_UNSIGNED: elem_size = alignment = sizeof(zeek_int_t); break;
+
+            case TYPE_INTERNAL_DOUBLE: elem_size = alignment = sizeof(double); break;
+
+            case TYPE_INTERNAL_ADDR:
+                elem_size = sizeof(uint32_t) * 4;
+                alignment = sizeof(uint32_t);
+                break;
+
+            case TYPE_INTERNAL_SUBNET:
+                elem_size = sizeof(uint32_t) * 5;
+                alignment = sizeof(uint32_t);
+                break;
+
+            default: return;
+        }
+
+        size = util::memory_size_align(size, alignment);
+        layout.push_back({it, size});
+        size += elem_size;
+    }
+
+    fixed_layout = std::move(layout);
+    fixed_key_size = size;
+}
+
+std::unique_ptr<HashKey> CompositeHash::MakeFixedHashKey(const Val& argv, bool type_check) const {
+    auto res = std::make_unique<HashKey>();
+    res->Reserve("fixed-layout", fixed_key_size);
+    res->Allocate();
+
+    if ( ! WriteFixedKey(argv, type_check, res->KeyAtWrite()) )
+        return nullptr;
+
+    res->SkipWrite("fixed-layout", fixed_key_size);
+
+    return res;
+}
+
+bool CompositeHash::WriteFixedKey(const Val& argv, bool type_check, void* buf) const {
+    if ( type_check && argv.GetType()->Tag() != TYPE_LIST )
+        return false;
+
+    auto lv = argv.AsListVal();
+
+    if ( type_check && static_cast<size_t>(lv->Length()) != fixed_layout.size() )
+        return false;
+
+    // Zero the whole key so that alignment padding is deterministic,
+    // as AlignWrite() does for the generic path.
+    auto kp = static_cast<char*>(buf);
+    memset(kp, 0, fixed_key_size);
+
+    for ( auto i = 0u; i < fixed_layout.size(); ++i ) {
+        const auto& fe = fixed_layout[i];
+        const auto& v = lv->Idx(i);
+
+        if ( ! v || (type_check && v->GetType()->InternalType() != fe.it) )
+            return false;
+
+        auto elem = kp + fe.offset;
+
+        switch ( fe.it ) {
+            case TYPE_INTERNAL_INT: {
+                zeek_int_t i_val = v->AsInt();
+                memcpy(elem, &i_val, sizeof(i_val));
+                break;
+            }
+
+            case TYPE_INTERNAL_UNSIGNED: {
+                zeek_uint_t u_val = v->AsCount();
+                memcpy(elem, &u_val, sizeof(u_val));
+                break;
+            }
+
+            case TYPE_INTERNAL_DOUBLE: {
+                double d_val = v->InternalDouble();
+                memcpy(elem, &d_val, sizeof(d_val));
+                break;
+            }
+
+            case TYPE_INTERNAL_ADDR: v->AsAddr().CopyIPv6(reinterpret_cast<uint32_t*>(elem)); break;
+
+            case TYPE_INTERNAL_SUBNET: {
+                const auto& sn = v->AsSubNet();
+                sn.Prefix().CopyIPv6(reinterpret_cast<uint32_t*>(elem));
+                int width = sn.Length();
+                memcpy(elem + sizeof(uint32_t) * 4, &width, sizeof(width));
+                break;
+            }
+
+            default: reporter->InternalError("bad internal type in CompositeHash::WriteFixedKey");
+        }
+    }
+
+    return true;
 }
 
 std::unique_ptr<HashKey> CompositeHash::MakeHashKey(const Val& argv, bool type_check) const {
+    if ( fixed_key_size > 0 )
+        return MakeFixedHashKey(argv, type_check);
+
     auto res = std::make_unique<HashKey>();
     const auto& tl = type->GetTypes();
 
@@ -801,3 +919,120 @@ bool CompositeHash::ReserveSingleTypeKeySize(HashKey& hk, Type* bt, const Val* v
 }
 
 } // namespace zeek::detail
+
+namespace {
+
+// Hashes every index through the generic, recursive path.
+class GenericCompositeHash : public zeek::detail::CompositeHash {
+public:
+    explicit GenericCompositeHash(zeek::TypeListPtr t) : CompositeHash(std::move(t)) { fixed_key_size = 0; }
+};
+
+void check_fixed_key(const zeek::TypeListPtr& tl, const zeek::ListValPtr& lv) {
+    zeek::detail::CompositeHash fixed(tl);
+    GenericCompositeHash generic(tl);
+    REQUIRE(fixed.FixedKeySize() > 0);
+
+    auto fk = fixed.MakeHashKey(*lv, true);
+    auto gk = generic.MakeHashKey(*lv, true);
+    REQUIRE(fk);
+    REQUIRE(gk);
+    REQUIRE(fk->Size() == gk->Size());
+    CHECK(memcmp(fk->Key(), gk->Key(), fk->Size()) == 0);
+    CHECK(fk->Hash() == gk->Hash());
+
+    alignas(double) char buf[256];
+    REQUIRE(fixed.FixedKeySize() <= sizeof(buf));
+    REQUIRE(fixed.WriteFixedKey(*lv, true, buf));
+    CHECK(memcmp(buf, gk->Key(), gk->Size()) == 0);
+
+    auto rv = fixed.RecoverVals(*fk);
+    REQUIRE(rv->Length() == lv->Length());
+
+    for ( auto i = 0; i < lv->Length(); ++i )
+        CHECK(zeek::obj_desc_short(rv->Idx(i).get()) == zeek::obj_desc_short(lv->Idx(i).get()));
+}
+
+} // namespace
+
+TEST_SUITE_BEGIN("CompositeHash");
+
+TEST_CASE("fixed layout keys match generic keys") {
+    using namespace zeek;
+
+    SUBCASE("addr, port, count, bool") {
+        auto tl = make_intrusive<TypeList>();
+        tl->Append(base_type(TYPE_ADDR));
+        tl->Append(base_type(TYPE_PORT));
+        tl->Append(base_type(TYPE_COUNT));
+        tl->Append(base_type(TYPE_BOOL));
+
+        for ( const auto* a : {"192.168.1.1", "2001:db8::1"} ) {
+            auto lv = make_intrusive<ListVal>(TYPE_ANY);
+            lv->Append(make_intrusive<AddrVal>(a));
+            lv->Append(val_mgr->Port(443, TRANSPORT_TCP));
+            lv->Append(val_mgr->Count(123456789));
+            lv->Append(val_mgr->Bool(true));
+            check_fixed_key(tl, lv);
+        }
+    }
+
+    SUBCASE("bool, addr, addr, port") {
+        // The bool leaves padding in front of the addresses.
+        auto tl = make_intrusive<TypeList>();
+        tl->Append(base_type(TYPE_BOOL));
+        tl->Append(base_type(TYPE_ADDR));
+        tl->Append(base_type(TYPE_ADDR));
+        tl->Append(base_type(TYPE_PORT));
+
+        auto lv = make_intrusive<ListVal>(TYPE_ANY);
+        lv->Append(val_mgr->Bool(false));
+        lv->Append(make_intrusive<AddrVal>("10.0.0.1"));
+        lv->Append(make_intrusive<AddrVal>("fe80::1"));
+        lv->Append(val_mgr->Port(53, TRANSPORT_UDP));
+        check_fixed_key(tl, lv);
+    }
+
+    SUBCASE("subnet, addr, count, int, double") {
+        auto tl = make_intrusive<TypeList>();
+        tl->Append(base_type(TYPE_SUBNET));
+        tl->Append(base_type(TYPE_ADDR));
+        tl->Append(base_type(TYPE_COUNT));
+        tl->Append(base_type(TYPE_INT));
+        tl->Append(base_type(TYPE_DOUBLE));
+
+        auto lv = make_intrusive<ListVal>(TYPE_ANY);
+        lv->Append(make_intrusive<SubNetVal>("10.0.0.0", 8));
+        lv->Append(make_intrusive<AddrVal>("10.1.2.3"));
+        lv->Append(val_mgr->Count(0));
+        lv->Append(make_intrusive<IntVal>(-5));
+        lv->Append(make_intrusive<DoubleVal>(1.5));
+        check_fixed_key(tl, lv);
+    }
+}
+
+TEST_CASE("fixed layout rejects mismatched indices") {
+    using namespace zeek;
+
+    auto tl = make_intrusive<TypeList>();
+    tl->Append(base_type(TYPE_ADDR));
+    tl->Append(base_type(TYPE_PORT));
+    detail::CompositeHash ch(tl);
+
+    auto short_lv = make_intrusive<ListVal>(TYPE_ANY);
+    short_lv->Append(make_intrusive<AddrVal>("10.0.0.1"));
+    CHECK_FALSE(ch.MakeHashKey(*short_lv, true));
+
+    auto wrong_lv = make_intrusive<ListVal>(TYPE_ANY);
+    wrong_lv->Append(make_intrusive<AddrVal>("10.0.0.1"));
+    wrong_lv->Append(val_mgr->Count(80));
+    CHECK_FALSE(ch.MakeHashKey(*wrong_lv, true));
+
+    // Indices with non-fixed-size types take the generic path.
+    auto stl = make_intrusive<TypeList>();
+    stl->Append(base_type(TYPE_ADDR));
+    stl->Append(base_type(TYPE_STRING));
+    CHECK(detail::CompositeHash(stl).FixedKeySize() == 0);
+}
+
+TEST_SUITE_END();
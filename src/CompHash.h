@@ -3,6 +3,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "zeek/Func.h"
 #include "zeek/Type.h"
@@ -29,6 +30,16 @@ public:
     // Given a hash key, recover the values used to create it.
     ListValPtr RecoverVals(const HashKey& k) const;
 
+    // The size of keys for index types with a fixed layout, else 0.
+    size_t FixedKeySize() const { return fixed_key_size; }
+
+    // Writes the key for a fixed-layout index into buf, which must hold
+    // FixedKeySize() bytes and be aligned like a double. This lets lookups
+    // that don't need to hold on to the key build it on the stack. The
+    // key is the same as the one MakeHashKey() returns. Returns false
+    // if v doesn't match the index type.
+    bool WriteFixedKey(const Val& v, bool type_check, void* buf) const;
+
     // The next three are public so OpaqueType hash overrides can
     // recurse into composite hashing for their inner element types.
     // They're otherwise internal.
@@ -52,6 +63,15 @@ protected:
 
     bool EnsureTypeReserve(HashKey& hk, const Val* v, Type* bt, bool type_check) const;
 
+    // Sets up fixed_layout if the (non-singleton) index type consists
+    // solely of fixed-size atomic types, such as [addr, port].
+    void BuildFixedLayout();
+
+    // Version of MakeHashKey() for indices that have a fixed layout.
+    // Writes each value directly at its precomputed offset rather than
+    // recursing over the types for size reservation and then writing.
+    std::unique_ptr<HashKey> MakeFixedHashKey(const Val& v, bool type_check) const;
+
     // The following are for allowing hashing of function values.
     // These can occur, for example, in sets of predicates that get
     // iterated over.  We use pointers in order to keep storage
@@ -65,6 +85,17 @@ protected:
 
     TypeListPtr type;
     bool is_singleton = false; // if just one type in index
+
+    // Where each element of a fixed-layout index lives in the key.
+    // The offsets match the layout the generic hashing produces, so
+    // the resulting keys are interchangeable with RecoverVals().
+    struct FixedElement {
+        InternalTypeTag it;
+        size_t offset;
+    };
+
+    std::vector<FixedElement> fixed_layout;
+    size_t fixed_key_size = 0; // if non-zero, fixed_layout is in use
 };
 
 } // namespace zeek::detail
@@ -81,7 +81,7 @@ Connection::Connection(zeek::IPBasedConnKeyPtr k, double t, uint32_t flow, const
     ++current_connections;
     ++total_connections;
 
-    encapsulation = pkt->encap;
+    encapsulation = EncapsulationStack::Intern(pkt->encap);
 }
 
 Connection::~Connection() {
@@ -118,7 +118,7 @@ void Connection::CheckEncapsulation(const std::shared_ptr<EncapsulationStack>& a
     if ( encapsulation && arg_encap ) {
         if ( *encapsulation != *arg_encap ) {
             enqueue_tunnel_changed(arg_encap->ToVal());
-            encapsulation = std::make_shared<EncapsulationStack>(*arg_encap);
+            encapsulation = EncapsulationStack::Intern(arg_encap);
         }
     }
 
@@ -130,7 +130,7 @@ void Connection::CheckEncapsulation(const std::shared_ptr<EncapsulationStack>& a
 
     else if ( arg_encap ) {
         enqueue_tunnel_changed(arg_encap->ToVal());
-        encapsulation = std::make_shared<EncapsulationStack>(*arg_encap);
+        encapsulation = EncapsulationStack::Intern(arg_encap);
     }
 }
 
@@ -252,6 +252,12 @@ const RecordValPtr& Connection::GetVal() {
             conn_val->Assign(10, inner_vlan.value());
     }
 
+    // Events raised back to back, as well as other callers between
+    // packets, get to reuse the record as it is. Walking the analyzer tree
+    // for updates is only necessary once something has changed since.
+    if ( val_current )
+        return conn_val;
+
     if ( adapter )
         adapter->UpdateConnVal(conn_val.get());
 
@@ -265,6 +271,7 @@ const RecordValPtr& Connection::GetVal() {
     }
 
     conn_val->SetOrigin(this);
+    val_current = true;
 
     return conn_val;
 }
@@ -275,7 +282,9 @@ analyzer::Analyzer* Connection::FindAnalyzer(const zeek::Tag& tag) {
     return adapter ? adapter->FindChild(tag) : nullptr;
 }
 
-analyzer::Analyzer* Connection::FindAnalyzer(const char* name) { return adapter->FindChild(name); }
+analyzer::Analyzer* Connection::FindAnalyzer(const char* name) {
+    return adapter ? adapter->FindChild(name) : nullptr;
+}
 
 void Connection::Match(detail::Rule::PatternType type, const u_char* data, int len, bool is_orig, bool bol, bool eol,
                        bool clear_state) {
@@ -284,8 +293,12 @@ void Connection::Match(detail::Rule::PatternType type, const u_char* data, int l
 }
 
 void Connection::RemovalEvent() {
-    if ( connection_state_remove )
+    if ( connection_state_remove ) {
+        // This is the record that ends up in conn.log, so don't rely on
+        // everybody having flagged their changes.
+        InvalidateVal();
         EnqueueEvent(connection_state_remove, nullptr, GetVal());
+    }
 }
 
 void Connection::Weird(const char* name, const char* addl, const char* source) {
@@ -346,8 +359,7 @@ void Connection::FlipRoles() {
 
     AddHistory('^');
 
-    if ( connection_flipped )
-        EnqueueEvent(connection_flipped, nullptr, GetVal());
+    EnqueueEvent(connection_flipped, nullptr, [this]() { return zeek::Args{GetVal()}; });
 }
 
 void Connection::Describe(ODesc* d) const {
@@ -397,6 +409,7 @@ void Connection::IDString(ODesc* d) const {
 void Connection::SetSessionAdapter(packet_analysis::IP::SessionAdapter* aa, analyzer::pia::PIA* pia) {
     adapter = aa;
     primary_PIA = pia;
+    InvalidateVal();
 }
 
 void Connection::CheckFlowLabel(bool is_orig, uint32_t flow_label) {
@@ -424,9 +437,40 @@ void Connection::CheckFlowLabel(bool is_orig, uint32_t flow_label) {
 
 bool Connection::PermitWeird(const char* name, uint64_t threshold, uint64_t rate, double duration) {
     if ( ! weird_state )
-        weird_state = std::make_unique<detail::WeirdStateMap>();
+        weird_state = std::make_unique<detail::CompactWeirdStateMap>();
 
     return detail::PermitWeird(*weird_state, name, threshold, rate, duration);
 }
 
+static size_t count_analyzers(analyzer::Analyzer* a) {
+    size_t n = 1;
+
+    for ( auto* child : a->GetChildren() )
+        n += count_analyzers(child);
+
+    return n;
+}
+
+Connection::MemoryUsage Connection::GetMemoryUsage() {
+    MemoryUsage mu;
+
+    mu.object = sizeof(*this);
+
+    if ( history.capacity() > std::string().capacity() )
+        mu.history = history.capacity() + 1;
+
+    if ( weird_state )
+        mu.weird_state = weird_state->MemoryAllocation();
+
+    if ( encapsulation )
+        mu.encapsulation = encapsulation->MemoryAllocation() / encapsulation.use_count();
+
+    mu.timers = timers.size() * sizeof(session::detail::Timer);
+
+    if ( adapter )
+        mu.analyzers = count_analyzers(adapter);
+
+    return mu;
+}
+
 } // namespace zeek
@@ -193,6 +193,24 @@ public:
     // Returns true once Done() is called.
     bool IsFinished() { return finished; }
 
+    /**
+     * A breakdown of the memory a connection uses, in bytes unless noted
+     * otherwise. State that analyzers keep isn't included.
+     */
+    struct MemoryUsage {
+        size_t object = 0;        // The connection object itself.
+        size_t history = 0;       // Heap storage of the history beyond the object.
+        size_t weird_state = 0;   // Rate-limiting state for the connection's weirds.
+        size_t encapsulation = 0; // The tunnel stack, divided among connections sharing it.
+        size_t timers = 0;        // Pending timers.
+        size_t analyzers = 0;     // Number of analyzers in the tree.
+    };
+
+    /**
+     * Returns the connection's current memory usage.
+     */
+    MemoryUsage GetMemoryUsage();
+
     // Runs after all scripts have been parsed.
     static void InitPostScript();
 
@@ -206,12 +224,7 @@ private:
     std::optional<uint16_t> vlan, inner_vlan;  // VLAN this connection traverses, if available
     u_char orig_l2_addr[Packet::L2_ADDR_LEN];  // Link-layer originator address, if available
     u_char resp_l2_addr[Packet::L2_ADDR_LEN];  // Link-layer responder address, if available
-    int suppress_event;                        // suppress certain events to once per conn.
-    RecordValPtr conn_val;
-    std::shared_ptr<EncapsulationStack> encapsulation; // tunnels
-
-    IPBasedConnKeyPtr key;
-
+    uint8_t suppress_event;                    // suppress certain events to once per conn.
     TransportProto proto;
     uint8_t tunnel_changes = 0;
     bool weird;
@@ -219,11 +232,16 @@ private:
     bool saw_first_orig_packet;
     bool saw_first_resp_packet;
 
+    RecordValPtr conn_val;
+    std::shared_ptr<EncapsulationStack> encapsulation; // tunnels
+
+    IPBasedConnKeyPtr key;
+
     packet_analysis::IP::SessionAdapter* adapter;
     analyzer::pia::PIA* primary_PIA;
 
     UID uid; // Globally unique connection ID.
-    std::unique_ptr<detail::WeirdStateMap> weird_state;
+    std::unique_ptr<detail::CompactWeirdStateMap> weird_state;
 
     // Count number of connections.
     static uint64_t total_connections;
@@ -2,6 +2,8 @@
 
 #include "zeek/Dict.h"
 
+#include <string>
+
 #include "zeek/Hash.h"
 
 #include "zeek/3rdparty/doctest.h"
@@ -434,6 +436,50 @@ TEST_CASE("dict iterator invalidation") {
     delete key3;
 }
 
+TEST_CASE("dict key sizes") {
+#ifndef ZEEK_DICT_DEBUG
+    CHECK(sizeof(detail::DictEntry<uint32_t>) == 24);
+#endif
+
+    PDict<uint32_t> dict;
+
+    // One key for each of the inline, pointer and long key storage.
+    std::string short_key(4, 'a');
+    std::string medium_key(1000, 'b');
+    std::string long_key(100000, 'c');
+    uint32_t vals[] = {1, 2, 3};
+
+    detail::HashKey* keys[] = {new detail::HashKey(short_key.data(), short_key.size()),
+                               new detail::HashKey(medium_key.data(), medium_key.size()),
+                               new detail::HashKey(long_key.data(), long_key.size())};
+
+    for ( int i = 0; i < 3; ++i )
+        dict.Insert(keys[i], &vals[i]);
+
+    CHECK(dict.Length() == 3);
+
+    for ( int i = 0; i < 3; ++i )
+        CHECK(*dict.Lookup(keys[i]) == vals[i]);
+
+    // A long key that only differs in its size mustn't match.
+    std::string longer_key = long_key + "c";
+    detail::HashKey longer(longer_key.data(), longer_key.size());
+    CHECK(dict.Lookup(&longer) == nullptr);
+
+    for ( const auto& entry : dict ) {
+        auto hk = entry.GetHashKey();
+        if ( hk->Size() == long_key.size() )
+            CHECK(memcmp(hk->Key(), long_key.data(), long_key.size()) == 0);
+    }
+
+    dict.Remove(keys[2]);
+    CHECK(dict.Length() == 2);
+    CHECK(dict.Lookup(keys[2]) == nullptr);
+
+    for ( auto k : keys )
+        delete k;
+}
+
 // private
 void generic_delete_func(void* v) { free(v); }
 
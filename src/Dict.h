@@ -89,13 +89,19 @@ public:
     // Distance from the expected position in the table. 0xFFFF means that the entry is empty.
     uint16_t distance = TOO_FAR_TO_REACH;
 
-    // The size of the key. Less than 8 bytes we'll store directly in the entry, otherwise we'll
-    // store it as a pointer. This avoids extra allocations if we can help it.
-    uint32_t key_size = 0;
+    // The size of the key, if it's less than LONG_KEY_SIZE. Keys of up to 8 bytes we'll store
+    // directly in the entry, otherwise we'll store them as a pointer. This avoids extra
+    // allocations if we can help it. Keys of LONG_KEY_SIZE or more bytes are rare, so for those
+    // we keep the full size in front of the key data, which lets the distance, size and hash
+    // all share a single 8-byte word.
+    uint16_t short_key_size = 0;
+
+    // Sentinel for short_key_size indicating that the size is stored with the key data.
+    static constexpr uint16_t LONG_KEY_SIZE = UINT16_MAX;
 
     // The maximum value of the key size above. This allows Dictionary to truncate keys before
     // they get stored into an entry to avoid weird overflow errors.
-    static constexpr uint32_t MAX_KEY_SIZE = UINT32_MAX;
+    static constexpr uint32_t MAX_KEY_SIZE = UINT32_MAX - sizeof(uint32_t);
 
     // Lower 4 bytes of the 8-byte hash, which is used to calculate the position in the table.
     uint32_t hash = 0;
@@ -108,7 +114,10 @@ public:
 
     DictEntry(void* arg_key, uint32_t key_size = 0, hash_t hash = 0, T* value = nullptr, int16_t d = TOO_FAR_TO_REACH,
               bool copy_key = false)
-        : distance(d), key_size(key_size), hash(static_cast<uint32_t>(hash)), value(value) {
+        : distance(d),
+          short_key_size(static_cast<uint16_t>(std::min<uint32_t>(key_size, LONG_KEY_SIZE))),
+          hash(static_cast<uint32_t>(hash)),
+          value(value) {
         if ( ! arg_key )
             return;
 
@@ -117,7 +126,7 @@ public:
             if ( ! copy_key )
                 delete[] reinterpret_cast<char*>(arg_key); // own the arg_key, now don't need it.
         }
-        else {
+        else if ( key_size < LONG_KEY_SIZE ) {
             if ( copy_key ) {
                 key = new char[key_size];
                 memcpy(key, arg_key, key_size);
@@ -126,6 +135,14 @@ public:
                 key = reinterpret_cast<char*>(arg_key);
             }
         }
+        else {
+            // Long keys always get copied to make room for the size.
+            key = new char[sizeof(uint32_t) + key_size];
+            memcpy(key, &key_size, sizeof(uint32_t));
+            memcpy(key + sizeof(uint32_t), arg_key, key_size);
+            if ( ! copy_key )
+                delete[] reinterpret_cast<char*>(arg_key);
+        }
     }
 
     bool Empty() const { return distance == TOO_FAR_TO_REACH; }
@@ -136,29 +153,44 @@ public:
         hash = 0;
         key = nullptr;
         value = nullptr;
-        key_size = 0;
+        short_key_size = 0;
         bucket = 0;
 #endif // ZEEK_DICT_DEBUG
     }
 
     void Clear() {
-        if ( key_size > 8 )
+        if ( short_key_size > 8 )
             delete[] key;
         SetEmpty();
     }
 
-    const char* GetKey() const { return key_size <= 8 ? key_here : key; }
+    uint32_t KeySize() const {
+        if ( short_key_size < LONG_KEY_SIZE )
+            return short_key_size;
+
+        uint32_t key_size;
+        memcpy(&key_size, key, sizeof(uint32_t));
+        return key_size;
+    }
+
+    const char* GetKey() const {
+        if ( short_key_size <= 8 )
+            return key_here;
+
+        return short_key_size < LONG_KEY_SIZE ? key : key + sizeof(uint32_t);
+    }
+
     std::unique_ptr<detail::HashKey> GetHashKey() const {
-        return std::make_unique<detail::HashKey>(GetKey(), key_size, hash);
+        return std::make_unique<detail::HashKey>(GetKey(), KeySize(), hash);
     }
 
     bool Equal(const char* arg_key, uint32_t arg_key_size, hash_t arg_hash) const { // only 40-bit hash comparison.
-        return (0 == ((hash ^ arg_hash) & HASH_MASK)) && key_size == arg_key_size &&
-               0 == memcmp(GetKey(), arg_key, key_size);
+        return (0 == ((hash ^ arg_hash) & HASH_MASK)) && KeySize() == arg_key_size &&
+               0 == memcmp(GetKey(), arg_key, arg_key_size);
     }
 
-    bool operator==(const DictEntry& r) const { return Equal(r.GetKey(), r.key_size, r.hash); }
-    bool operator!=(const DictEntry& r) const { return ! Equal(r.GetKey(), r.key_size, r.hash); }
+    bool operator==(const DictEntry& r) const { return Equal(r.GetKey(), r.KeySize(), r.hash); }
+    bool operator!=(const DictEntry& r) const { return ! Equal(r.GetKey(), r.KeySize(), r.hash); }
 };
 
 using DictEntryVec = std::vector<detail::HashKey>;
@@ -848,7 +880,7 @@ public:
         for ( int i = 0; i < Capacity(); i++ ) {
             if ( table[i].Empty() )
                 continue;
-            key_size += zeek::util::pad_size(table[i].key_size);
+            key_size += zeek::util::pad_size(table[i].KeySize());
             if ( ! table[i].value )
                 continue;
         }
@@ -880,7 +912,7 @@ public:
                     printf("%'10d %1s %'10d %4d %4d 0x%08x 0x%016" PRIx64 "(%3ld) %2d\n", i,
                            (i <= remap_end ? "*" : ""), BucketByPosition(i), table[i].distance,
                            OffsetInClusterByPosition(i), uint(table[i].hash), FibHash(table[i].hash),
-                           FibHash(table[i].hash) & 0xFF, table[i].key_size);
+                           FibHash(table[i].hash) & 0xFF, table[i].KeySize());
         }
     }
 
@@ -915,7 +947,7 @@ public:
 
         bool binary = false;
         const char* key = table[i].GetKey();
-        for ( int j = 0; j < table[i].key_size; j++ )
+        for ( int j = 0; j < table[i].KeySize(); j++ )
             if ( ! isprint(key[j]) ) {
                 binary = true;
                 break;
@@ -929,9 +961,9 @@ public:
             std::ofstream f(key_file, std::ios::binary | std::ios::out | std::ios::trunc);
             for ( int idx = 0; idx < Capacity(); idx++ )
                 if ( ! table[idx].Empty() ) {
-                    int key_size = table[idx].key_size;
+                    int key_size = table[idx].KeySize();
                     f.write(reinterpret_cast<const char*>(&key_size), sizeof(int));
-                    f.write(table[idx].GetKey(), table[idx].key_size);
+                    f.write(table[idx].GetKey(), table[idx].KeySize());
                 }
         }
         else {
@@ -940,7 +972,7 @@ public:
             std::ofstream f(key_file, std::ios::out | std::ios::trunc);
             for ( int idx = 0; idx < Capacity(); idx++ )
                 if ( ! table[idx].Empty() ) {
-                    std::string s{table[idx].GetKey(), table[idx].key_size};
+                    std::string s{table[idx].GetKey(), table[idx].KeySize()};
                     f << s << "\n";
                 }
             f << std::flush;
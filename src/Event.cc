@@ -6,6 +6,7 @@
 
 #include "zeek/Desc.h"
 #include "zeek/EventRegistry.h"
+#include "zeek/Flare.h"
 #include "zeek/Trigger.h"
 #include "zeek/Type.h"
 #include "zeek/Val.h"
@@ -16,6 +17,8 @@
 #include "const.bif.netvar_h"
 #include "event.bif.netvar_h"
 
+#include "zeek/3rdparty/doctest.h"
+
 zeek::EventMgr zeek::event_mgr;
 
 namespace zeek {
@@ -41,6 +44,105 @@ RecordValPtr detail::MetadataEntry::BuildVal() const {
     return rv;
 }
 
+detail::EventIngressQueue::~EventIngressQueue() {
+    while ( Pop() )
+        ;
+}
+
+bool detail::EventIngressQueue::Push(std::unique_ptr<Entry>& entry, bool* was_empty) {
+    // Reserve a slot first so the bound holds without any locking.
+    auto n = size.fetch_add(1, std::memory_order_acq_rel);
+
+    if ( n >= capacity ) {
+        size.fetch_sub(1, std::memory_order_acq_rel);
+        return false;
+    }
+
+    *was_empty = (n == 0);
+
+    Entry* e = entry.release();
+    e->next.store(nullptr, std::memory_order_relaxed);
+    Entry* prev = tail.exchange(e, std::memory_order_acq_rel);
+
+    // Until this store, the consumer can't see the entry nor any appended
+    // after it.
+    prev->next.store(e, std::memory_order_release);
+    return true;
+}
+
+std::unique_ptr<detail::EventIngressQueue::Entry> detail::EventIngressQueue::Pop() {
+    Entry* h = head;
+    Entry* next = h->next.load(std::memory_order_acquire);
+
+    if ( h == &stub ) {
+        if ( ! next )
+            return nullptr;
+
+        head = h = next;
+        next = h->next.load(std::memory_order_acquire);
+    }
+
+    if ( ! next ) {
+        if ( h != tail.load(std::memory_order_acquire) )
+            // A producer is still linking in the next entry.
+            return nullptr;
+
+        // h is the last entry. Put the stub back behind it so that h can
+        // be unlinked without leaving the queue without a tail.
+        stub.next.store(nullptr, std::memory_order_relaxed);
+        Entry* prev = tail.exchange(&stub, std::memory_order_acq_rel);
+        prev->next.store(&stub, std::memory_order_release);
+
+        next = h->next.load(std::memory_order_acquire);
+
+        if ( ! next )
+            return nullptr;
+    }
+
+    head = next;
+    size.fetch_sub(1, std::memory_order_acq_rel);
+    return std::unique_ptr<Entry>(h);
+}
+
+detail::EventCoalescer::EventCoalescer(const EventHandlerPtr& batch_handler) : handler(batch_handler) {
+    event_mgr.coalescers.push_back(this);
+}
+
+detail::EventCoalescer::~EventCoalescer() { std::erase(event_mgr.coalescers, this); }
+
+void detail::EventCoalescer::Add(const zeek::Args& args) {
+    if ( ! batch_type ) {
+        const auto& params = handler->GetType()->ParamList()->GetTypes();
+
+        if ( params.size() != 1 || params[0]->Tag() != TYPE_VECTOR ||
+             params[0]->AsVectorType()->Yield()->Tag() != TYPE_RECORD )
+            reporter->InternalError("batched event %s must take a single vector of records", handler->Name());
+
+        batch_type = cast_intrusive<VectorType>(params[0]);
+        entry_type = cast_intrusive<RecordType>(batch_type->Yield());
+    }
+
+    if ( ! batch ) {
+        batch = make_intrusive<VectorVal>(batch_type);
+        batch_start = run_state::network_time;
+    }
+
+    auto entry = make_intrusive<RecordVal>(entry_type);
+
+    for ( size_t i = 0; i < args.size(); ++i )
+        entry->Assign(static_cast<int>(i), args[i]);
+
+    batch->Append(std::move(entry));
+
+    if ( batch->Size() >= BifConst::event_batch_size )
+        Flush();
+}
+
+void detail::EventCoalescer::Flush() {
+    if ( batch )
+        event_mgr.Enqueue(handler, std::move(batch));
+}
+
 Event::Event(detail::EventMetadataVectorPtr arg_meta, const EventHandlerPtr& arg_handler, zeek::Args arg_args,
              util::detail::SourceID arg_src, analyzer::ID arg_aid, Obj* arg_obj)
     : handler(arg_handler),
@@ -249,7 +351,83 @@ void EventMgr::Dispatch(const EventHandlerPtr& h, zeek::Args vl) {
     Unref(ev);
 }
 
+bool EventMgr::EnqueueFromThread(const EventHandlerPtr& h, std::function<zeek::Args()> make_args,
+                                 util::detail::SourceID src, bool block) {
+    if ( std::this_thread::get_id() == main_thread_id ) {
+        Enqueue(h, make_args(), src);
+        return true;
+    }
+
+    auto entry = std::make_unique<detail::EventIngressQueue::Entry>();
+    entry->handler = h;
+    entry->make_args = std::move(make_args);
+    entry->src = src;
+
+    bool was_empty = false;
+
+    if ( ! ingress_open.load(std::memory_order_acquire) )
+        return false;
+
+    while ( ! ingress.Push(entry, &was_empty) ) {
+        if ( ! block )
+            return false;
+
+        // Full; wait for the main thread to make room.
+        std::unique_lock lock(ingress_mtx);
+        ingress_waiters.fetch_add(1);
+
+        // Pairs with the fence in ProcessIngress(): either the main thread
+        // sees us waiting, or we see the room it made.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        ingress_room.wait(lock, [this] {
+            return ingress.Size() < ingress.Capacity() || ! ingress_open.load(std::memory_order_acquire);
+        });
+
+        ingress_waiters.fetch_sub(1);
+
+        if ( ! ingress_open.load(std::memory_order_acquire) )
+            return false;
+    }
+
+    // Only the first event needs to wake up the main thread. Later ones
+    // find the flare still burning or get picked up along with the first.
+    if ( was_empty )
+        ingress_flare->Fire();
+
+    return true;
+}
+
+void EventMgr::ProcessIngress() {
+    // Don't loop forever if producers keep up with us, the IO loop comes
+    // back here as long as GetNextTimeout() sees more.
+    for ( size_t n = ingress.Size(); n > 0; --n ) {
+        auto entry = ingress.Pop();
+        if ( ! entry )
+            break;
+
+        Enqueue(entry->handler, entry->make_args(), entry->src);
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if ( ingress_waiters.load() > 0 ) {
+        std::scoped_lock lock(ingress_mtx);
+        ingress_room.notify_all();
+    }
+}
+
 void EventMgr::Drain() {
+    // Pick up events from other threads here, too, so they don't wait for
+    // the IO loop during startup and termination.
+    if ( ingress.Size() > 0 )
+        ProcessIngress();
+
+    for ( auto* c : coalescers ) {
+        if ( c->batch && run_state::network_time - c->batch_start >= BifConst::event_batch_delay )
+            c->Flush();
+    }
+
     if ( event_queue_flush_point )
         Enqueue(event_queue_flush_point, Args{});
 
@@ -288,6 +466,11 @@ void EventMgr::Drain() {
     detail::trigger_mgr->Process();
 }
 
+void EventMgr::FlushCoalescedEvents() {
+    for ( auto* c : coalescers )
+        c->Flush();
+}
+
 void EventMgr::Describe(ODesc* d) const {
     int n = 0;
     Event* e;
@@ -307,6 +490,23 @@ void EventMgr::Process() {
     // to call Drain() as part of this method. It will get called at
     // the end of run_loop after all of the sources have been processed
     // and had the opportunity to spawn new events.
+    //
+    // Extinguish before looking at the ingress queue: a producer finding
+    // it empty afterwards fires the flare again.
+    if ( ingress_flare )
+        ingress_flare->Extinguish();
+
+    ProcessIngress();
+}
+
+void EventMgr::Done() {
+    {
+        std::scoped_lock lock(ingress_mtx);
+        ingress_open.store(false, std::memory_order_release);
+    }
+
+    // Don't leave producers waiting for room that's never going to come.
+    ingress_room.notify_all();
 }
 
 void EventMgr::InitPostScript() {
@@ -331,5 +531,135 @@ void EventMgr::InitPostScript() {
 
 
     iosource_mgr->Register(this, true, false);
+
+    ingress_flare = std::make_unique<detail::Flare>();
+
+    if ( ! iosource_mgr->RegisterFd(ingress_flare->FD(), this) )
+        zeek::reporter->FatalError("Failed to register event ingress flare");
+
+    ingress_open.store(true, std::memory_order_release);
 }
 } // namespace zeek
+
+TEST_SUITE_BEGIN("event ingress queue");
+
+namespace {
+
+using zeek::detail::EventIngressQueue;
+
+// The tests can't create Vals, so an entry's argument function reports
+// the value it was created with through *out instead.
+std::unique_ptr<EventIngressQueue::Entry> MakeEntry(int value, int* out) {
+    auto e = std::make_unique<EventIngressQueue::Entry>();
+    e->make_args = [value, out]() {
+        *out = value;
+        return zeek::Args{};
+    };
+    return e;
+}
+
+} // namespace
+
+TEST_CASE("bounded") {
+    EventIngressQueue q(2);
+    bool was_empty = false;
+    int out;
+
+    CHECK(q.Pop() == nullptr);
+
+    auto e = MakeEntry(1, &out);
+    CHECK(q.Push(e, &was_empty));
+    CHECK(was_empty);
+    e = MakeEntry(2, &out);
+    CHECK(q.Push(e, &was_empty));
+    CHECK_FALSE(was_empty);
+    e = MakeEntry(3, &out);
+    CHECK_FALSE(q.Push(e, &was_empty));
+    CHECK(e != nullptr);
+    CHECK(q.Size() == 2);
+
+    q.Pop()->make_args();
+    CHECK(out == 1);
+    CHECK(q.Push(e, &was_empty));
+    q.Pop()->make_args();
+    CHECK(out == 2);
+    q.Pop()->make_args();
+    CHECK(out == 3);
+    CHECK(q.Pop() == nullptr);
+    CHECK(q.Size() == 0);
+
+    e = MakeEntry(4, &out);
+    CHECK(q.Push(e, &was_empty));
+    CHECK(was_empty);
+}
+
+TEST_CASE("multiple producers") {
+    constexpr int producers = 4;
+    constexpr int per_producer = 20000;
+
+    EventIngressQueue q(64);
+    std::vector<std::thread> threads;
+    int out;
+
+    for ( int p = 0; p < producers; ++p )
+        threads.emplace_back([&q, &out, p]() {
+            bool was_empty;
+
+            for ( int i = 0; i < per_producer; ++i ) {
+                auto e = MakeEntry(p * per_producer + i, &out);
+                while ( ! q.Push(e, &was_empty) )
+                    std::this_thread::yield();
+            }
+        });
+
+    // Entries of each producer arrive in order and none get lost.
+    int next[producers] = {0};
+    int received = 0;
+
+    while ( received < producers * per_producer ) {
+        auto e = q.Pop();
+        if ( ! e ) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        CHECK(q.Size() <= q.Capacity());
+
+        e->make_args();
+        int p = out / per_producer;
+        REQUIRE(p < producers);
+        CHECK(out % per_producer == next[p]);
+        next[p] = out % per_producer + 1;
+        ++received;
+    }
+
+    for ( auto& t : threads )
+        t.join();
+
+    CHECK(q.Pop() == nullptr);
+    CHECK(q.Size() == 0);
+}
+
+TEST_SUITE_END();
+
+TEST_SUITE_BEGIN("event manager");
+
+TEST_CASE("lazy arguments") {
+    int calls = 0;
+    auto make_args = [&calls]() {
+        ++calls;
+        return zeek::Args{};
+    };
+
+    SUBCASE("no handler") { zeek::event_mgr.Enqueue(zeek::EventHandlerPtr(), make_args); }
+
+    SUBCASE("handler without bodies") {
+        zeek::EventHandler h("lazy_arguments_test");
+        zeek::event_mgr.Enqueue(zeek::EventHandlerPtr(&h), make_args);
+    }
+
+    CHECK(calls == 0);
+    CHECK(! zeek::event_mgr.HasEvents());
+}
+
+TEST_SUITE_END();
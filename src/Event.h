@@ -4,6 +4,12 @@
 
 #include "zeek/zeek-config.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <tuple>
 #include <type_traits>
 #include <vector>
@@ -50,6 +56,114 @@ EventMetadataVectorPtr MakeEventMetadataVector(double t);
 
 constexpr double NO_TIMESTAMP = -1.0;
 
+class Flare;
+
+/**
+ * A bounded, lock-free multi-producer single-consumer queue for events
+ * originating outside of Zeek's main thread. This is Vyukov's intrusive MPSC
+ * queue: producers link in an entry with a single atomic exchange and never
+ * wait for each other or for the consumer, which is always the main thread.
+ *
+ * The queue holds functions producing an event's arguments rather than the
+ * arguments themselves, as Vals may only be created on the main thread.
+ */
+class EventIngressQueue {
+public:
+    struct Entry {
+        EventHandlerPtr handler;
+        std::function<zeek::Args()> make_args;
+        util::detail::SourceID src = util::detail::SOURCE_LOCAL;
+        std::atomic<Entry*> next = nullptr;
+    };
+
+    explicit EventIngressQueue(size_t capacity) : capacity(capacity) {}
+    ~EventIngressQueue();
+
+    EventIngressQueue(const EventIngressQueue&) = delete;
+    EventIngressQueue& operator=(const EventIngressQueue&) = delete;
+
+    /**
+     * Appends an entry. Safe to call from any thread.
+     *
+     * @param entry The entry to append. Left untouched if the queue is full.
+     *
+     * @param was_empty Set to true if the queue was empty before, meaning
+     * the consumer needs to be woken up.
+     *
+     * @return False if the queue is full.
+     */
+    bool Push(std::unique_ptr<Entry>& entry, bool* was_empty);
+
+    /**
+     * Removes the oldest entry. Must only be called by the consumer.
+     *
+     * @return The entry, or nullptr if there's none. This may also happen
+     * while Size() is non-zero, if a producer is halfway through appending
+     * the next entry.
+     */
+    std::unique_ptr<Entry> Pop();
+
+    /**
+     * Returns the number of entries queued, including any that producers
+     * are in the middle of appending.
+     */
+    size_t Size() const { return size.load(std::memory_order_acquire); }
+
+    size_t Capacity() const { return capacity; }
+
+private:
+    Entry stub;
+    Entry* head = &stub;              // Only accessed by the consumer.
+    std::atomic<Entry*> tail = &stub; // Exchanged by producers.
+    std::atomic<size_t> size = 0;
+    size_t capacity;
+};
+
+/**
+ * Coalesces a frequently generated event into a batched variant of it, such
+ * as ``new_packet`` into ``new_packet_batch``. The batched
+ * event takes a single vector of records, with the records' fields matching
+ * the original event's parameters.
+ *
+ * A batch is raised once it holds ``event_batch_size`` entries, once its
+ * first entry is older than ``event_batch_delay`` in network time, and when
+ * Zeek terminates.
+ */
+class EventCoalescer {
+public:
+    explicit EventCoalescer(const EventHandlerPtr& batch_handler);
+    ~EventCoalescer();
+
+    EventCoalescer(const EventCoalescer&) = delete;
+    EventCoalescer& operator=(const EventCoalescer&) = delete;
+
+    /**
+     * Returns true if the batched event has any handlers. Callers check this
+     * before building arguments for Add().
+     */
+    explicit operator bool() const { return static_cast<bool>(handler); }
+
+    /**
+     * Appends an instance of the original event to the current batch,
+     * raising the batch if it's full.
+     */
+    void Add(const zeek::Args& args);
+
+    /**
+     * Raises the current batch, if there's any.
+     */
+    void Flush();
+
+private:
+    friend class zeek::EventMgr;
+
+    EventHandlerPtr handler;
+    VectorTypePtr batch_type;
+    RecordTypePtr entry_type;
+    VectorValPtr batch;
+    double batch_start = 0.0;
+};
+
 } // namespace detail
 
 class Event final : public Obj {
@@ -127,6 +241,21 @@ public:
         return Enqueue(h, zeek::Args{std::forward<Args>(args)...});
     }
 
+    /**
+     * A version of Enqueue() that only builds the argument list if the
+     * event has any handlers. Unlike the other versions, this doesn't
+     * queue events without handlers at all.
+     *
+     * @param h  reference to the event handler to later call.
+     * @param make_args  produces the argument list for the event handler call.
+     */
+    template<class F>
+        requires std::is_invocable_r_v<zeek::Args, F>
+    void Enqueue(const EventHandlerPtr& h, F&& make_args) {
+        if ( h )
+            Enqueue(h, std::forward<F>(make_args)());
+    }
+
     /**
      * Enqueue() with metadata vector support.
      * @param meta  Metadata to attach to the event, can be nullptr.
@@ -146,7 +275,39 @@ public:
     // invoked on the Event instance regardless.
     void Dispatch(const EventHandlerPtr& h, zeek::Args vl);
 
+    /**
+     * Adds an event to the queue from a thread other than the main thread.
+     * This doesn't take any locks: the event goes into a lock-free ingress
+     * queue that the main thread moves into the regular queue when woken up
+     * through a flare, or when it drains events anyway.
+     *
+     * Vals must only be created and referenced on the main thread, so the
+     * event's arguments are passed as a function that the main thread calls
+     * when it picks up the event. The function must therefore only capture
+     * plain data.
+     *
+     * Calling this from the main thread enqueues the event right away.
+     *
+     * @param h  reference to the event handler to later call.
+     * @param make_args  produces the argument list for the event handler call.
+     * @param src  indicates the origin of the event (local versus remote).
+     * @param block  if the ingress queue is full, wait for room if true,
+     * otherwise give up.
+     *
+     * @return True if the event was queued. False if the ingress queue is
+     * full and \a block is false, or if the event manager isn't accepting
+     * events from other threads (yet or anymore).
+     */
+    bool EnqueueFromThread(const EventHandlerPtr& h, std::function<zeek::Args()> make_args,
+                           util::detail::SourceID src = util::detail::SOURCE_LOCAL, bool block = true);
+
     void Drain();
+
+    /**
+     * Raises all pending batches of coalesced events right away.
+     */
+    void FlushCoalescedEvents();
+
     bool IsDraining() const { return current != nullptr; }
 
     bool HasEvents() const { return head != nullptr; }
@@ -171,7 +332,7 @@ public:
 
     // Let the IO loop know when there's more events to process
     // by returning a zero-timeout.
-    double GetNextTimeout() override { return head ? 0.0 : -1.0; }
+    double GetNextTimeout() override { return head || ingress.Size() > 0 ? 0.0 : -1.0; }
 
     /**
      * @return A pointer to the currently dispatched event or nullptr.
@@ -179,18 +340,41 @@ public:
     const Event* CurrentEvent() const { return current; }
 
     void Process() override;
+    void Done() override;
     const char* Tag() override { return "EventManager"; }
     void InitPostScript();
 
     uint64_t num_events_queued = 0;
     uint64_t num_events_dispatched = 0;
 
+    // How many events other threads may queue before EnqueueFromThread()
+    // blocks or fails.
+    static constexpr size_t MAX_INGRESS_EVENTS = 10000;
+
 private:
+    friend class detail::EventCoalescer;
+
     void QueueEvent(Event* event);
 
+    // Moves events queued by other threads into the regular queue.
+    void ProcessIngress();
+
     Event* current = nullptr;
     Event* head = nullptr;
     Event* tail = nullptr;
+
+    detail::EventIngressQueue ingress{MAX_INGRESS_EVENTS};
+    std::unique_ptr<detail::Flare> ingress_flare;
+    std::atomic<bool> ingress_open = false;
+
+    // Producers finding the ingress queue full wait here until the main
+    // thread made room.
+    std::mutex ingress_mtx;
+    std::condition_variable ingress_room;
+    std::atomic<size_t> ingress_waiters = 0;
+    std::thread::id main_thread_id = std::this_thread::get_id();
+
+    std::vector<detail::EventCoalescer*> coalescers;
 };
 
 ZEEK_EXTERN_DATA EventMgr event_mgr;
@@ -1079,6 +1079,7 @@ void init_primary_bifs() {
     NetStats = id::find_type<RecordType>("NetStats");
     MatcherStats = id::find_type<RecordType>("MatcherStats");
     ConnStats = id::find_type<RecordType>("ConnStats");
+    ConnMemoryStats = id::find_type<RecordType>("ConnMemoryStats");
     ReassemblerStats = id::find_type<RecordType>("ReassemblerStats");
     DNSStats = id::find_type<RecordType>("DNSStats");
     GapStats = id::find_type<RecordType>("GapStats");
@@ -12,6 +12,8 @@
 #include "zeek/Val.h"
 #include "zeek/ZeekString.h"
 
+#include "zeek/3rdparty/doctest.h"
+
 namespace zeek {
 
 bool IPv6_Hdr::IsOptionTruncated(uint16_t off) const {
@@ -467,11 +469,6 @@ static inline bool isIPv6ExtHeader(uint8_t type) {
     }
 }
 
-IPv6_Hdr_Chain::~IPv6_Hdr_Chain() {
-    delete homeAddr;
-    delete finalDst;
-}
-
 void IPv6_Hdr_Chain::Init(const struct ip6_hdr* ip6, uint64_t total_len, bool set_next, uint16_t next) {
     length = 0;
     uint8_t current_type;
@@ -504,7 +501,7 @@ void IPv6_Hdr_Chain::Init(const struct ip6_hdr* ip6, uint64_t total_len, bool se
             next_type = next;
         }
 
-        chain.emplace_back(p);
+        Append(p);
 
         // Check for routing headers and remember final destination address.
         if ( current_type == IPPROTO_ROUTING )
@@ -523,36 +520,36 @@ void IPv6_Hdr_Chain::Init(const struct ip6_hdr* ip6, uint64_t total_len, bool se
 }
 
 bool IPv6_Hdr_Chain::IsFragment() const {
-    if ( chain.empty() ) {
+    if ( num_hdrs == 0 ) {
         reporter->InternalWarning("empty IPv6 header chain");
         return false;
     }
 
-    return chain.back().Type() == IPPROTO_FRAGMENT;
+    return Hdr(num_hdrs - 1).Type() == IPPROTO_FRAGMENT;
 }
 
 IPAddr IPv6_Hdr_Chain::SrcAddr() const {
     if ( homeAddr )
         return {*homeAddr};
 
-    if ( chain.empty() ) {
+    if ( num_hdrs == 0 ) {
         reporter->InternalWarning("empty IPv6 header chain");
         return {};
     }
 
-    return IPAddr{reinterpret_cast<const struct ip6_hdr*>(chain[0].Data())->ip6_src};
+    return IPAddr{reinterpret_cast<const struct ip6_hdr*>(Hdr(0).Data())->ip6_src};
 }
 
 IPAddr IPv6_Hdr_Chain::DstAddr() const {
     if ( finalDst )
         return {*finalDst};
 
-    if ( chain.empty() ) {
+    if ( num_hdrs == 0 ) {
         reporter->InternalWarning("empty IPv6 header chain");
         return {};
     }
 
-    return IPAddr{reinterpret_cast<const struct ip6_hdr*>(chain[0].Data())->ip6_dst};
+    return IPAddr{reinterpret_cast<const struct ip6_hdr*>(Hdr(0).Data())->ip6_dst};
 }
 
 void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16_t len) {
@@ -570,7 +567,7 @@ void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16_t le
         {
             if ( r->ip6r_segleft > 0 && r->ip6r_len >= 2 ) {
                 if ( r->ip6r_len % 2 == 0 )
-                    finalDst = new IPAddr(*addr);
+                    finalDst = IPAddr(*addr);
                 else
                     reporter->Weird(SrcAddr(), DstAddr(), "odd_routing0_len");
             }
@@ -583,7 +580,7 @@ void IPv6_Hdr_Chain::ProcessRoutingHeader(const struct ip6_rthdr* r, uint16_t le
         {
             if ( r->ip6r_segleft > 0 ) {
                 if ( r->ip6r_len == 2 )
-                    finalDst = new IPAddr(*addr);
+                    finalDst = IPAddr(*addr);
                 else
                     reporter->Weird(SrcAddr(), DstAddr(), "bad_routing2_len");
             }
@@ -629,7 +626,7 @@ void IPv6_Hdr_Chain::ProcessDstOpts(const struct ip6_dest* d, uint16_t len) {
                         if ( homeAddr )
                             reporter->Weird(SrcAddr(), DstAddr(), "multiple_home_addr_opts");
                         else
-                            homeAddr = new IPAddr(*reinterpret_cast<const in6_addr*>(data + sizeof(struct ip6_opt)));
+                            homeAddr = IPAddr(*reinterpret_cast<const in6_addr*>(data + sizeof(struct ip6_opt)));
                     }
                     else
                         reporter->Weird(SrcAddr(), DstAddr(), "bad_home_addr_len");
@@ -653,10 +650,10 @@ VectorValPtr IPv6_Hdr_Chain::ToVal() const {
     static auto ip6_ext_hdr_chain_type = id::find_type<VectorType>("ip6_ext_hdr_chain");
     auto rval = make_intrusive<VectorVal>(ip6_ext_hdr_chain_type);
 
-    for ( size_t i = 1; i < chain.size(); ++i ) {
-        auto v = chain[i].ToVal();
+    for ( size_t i = 1; i < num_hdrs; ++i ) {
+        auto v = Hdr(i).ToVal();
         auto ext_hdr = make_intrusive<RecordVal>(ip6_ext_hdr_type);
-        uint8_t type = chain[i].Type();
+        uint8_t type = Hdr(i).Type();
         ext_hdr->Assign(0, type);
 
         switch ( type ) {
@@ -693,28 +690,58 @@ IP_Hdr* IP_Hdr::Copy() const {
 IPv6_Hdr_Chain* IPv6_Hdr_Chain::Copy(const ip6_hdr* new_hdr) const {
     IPv6_Hdr_Chain* rval = new IPv6_Hdr_Chain;
     rval->length = length;
+    rval->homeAddr = homeAddr;
+    rval->finalDst = finalDst;
 
-    if ( homeAddr )
-        rval->homeAddr = new IPAddr(*homeAddr);
-
-    if ( finalDst )
-        rval->finalDst = new IPAddr(*finalDst);
-
-    if ( chain.empty() ) {
+    if ( num_hdrs == 0 ) {
         reporter->InternalWarning("empty IPv6 header chain");
         delete rval;
         return nullptr;
     }
 
     const u_char* new_data = reinterpret_cast<const u_char*>(new_hdr);
-    const u_char* old_data = chain[0].Data();
+    const u_char* old_data = Hdr(0).Data();
 
-    for ( const auto& c : chain ) {
+    for ( size_t i = 0; i < num_hdrs; ++i ) {
+        const auto& c = Hdr(i);
         int off = c.Data() - old_data;
-        rval->chain.emplace_back(c.Type(), new_data + off);
+        rval->Append({c.Type(), new_data + off});
     }
 
     return rval;
 }
 
 } // namespace zeek
+
+TEST_CASE("ipv6 header chain longer than inline storage") {
+    // An IPv6 header followed by ten minimal Destination Options headers
+    // (padded with Pad1 options) and a fragment header.
+    constexpr int num_opts = 10;
+    u_char pkt[40 + num_opts * 8 + 8] = {};
+    auto* ip6 = reinterpret_cast<struct ip6_hdr*>(pkt);
+    ip6->ip6_vfc = 0x60;
+    ip6->ip6_plen = htons(sizeof(pkt) - 40);
+    ip6->ip6_nxt = IPPROTO_DSTOPTS;
+
+    for ( int i = 0; i < num_opts; ++i )
+        pkt[40 + i * 8] = i < num_opts - 1 ? IPPROTO_DSTOPTS : IPPROTO_FRAGMENT;
+
+    auto* frag = reinterpret_cast<struct ip6_frag*>(pkt + 40 + num_opts * 8);
+    frag->ip6f_nxt = IPPROTO_TCP;
+    frag->ip6f_offlg = htons(0x0001);
+    frag->ip6f_ident = htonl(42);
+
+    zeek::IP_Hdr ip(ip6, false, sizeof(pkt));
+    CHECK(ip.NumHeaders() == num_opts + 2);
+    CHECK(ip.HdrLen() == sizeof(pkt));
+    CHECK(ip.IsFragment());
+    CHECK(ip.ID() == 42);
+    CHECK(ip.MF());
+    CHECK(ip.LastHeader() == IPPROTO_FRAGMENT);
+
+    std::unique_ptr<zeek::IP_Hdr> copy{ip.Copy()};
+    REQUIRE(copy);
+    CHECK(copy->NumHeaders() == num_opts + 2);
+    CHECK(copy->ID() == 42);
+    CHECK(copy->NextProto() == IPPROTO_TCP);
+}
@@ -16,13 +16,14 @@
 #include "net_util.h" // for struct ip6_hdr
 #endif
 
+#include <optional>
 #include <vector>
 
+#include "zeek/IPAddr.h"
 #include "zeek/IntrusivePtr.h"
 
 namespace zeek {
 
-class IPAddr;
 class RecordVal;
 class VectorVal;
 using RecordValPtr = IntrusivePtr<RecordVal>;
@@ -57,6 +58,8 @@ public:
      */
     IPv6_Hdr(uint8_t t, const u_char* d) : type(t), data(d) {}
 
+    IPv6_Hdr() = default;
+
     /**
      * Replace the value of the next protocol field.
      */
@@ -131,8 +134,8 @@ public:
     RecordValPtr ToVal() const;
 
 protected:
-    uint8_t type;
-    const u_char* data;
+    uint8_t type = 0;
+    const u_char* data = nullptr;
 
 private:
     bool IsOptionTruncated(uint16_t off) const;
@@ -145,8 +148,6 @@ public:
      */
     IPv6_Hdr_Chain(const struct ip6_hdr* ip6, uint64_t len) { Init(ip6, len, false); }
 
-    ~IPv6_Hdr_Chain();
-
     /**
      * @return a copy of the header chain, but with pointers to individual
      * IPv6 headers now pointing within \a new_hdr.
@@ -156,7 +157,7 @@ public:
     /**
      * Returns the number of headers in the chain.
      */
-    size_t Size() const { return chain.size(); }
+    size_t Size() const { return num_hdrs; }
 
     /**
      * Returns the sum of the length of all headers in the chain in bytes.
@@ -166,7 +167,7 @@ public:
     /**
      * Accesses the header at the given location in the chain.
      */
-    const IPv6_Hdr* operator[](const size_t i) const { return &chain[i]; }
+    const IPv6_Hdr* operator[](const size_t i) const { return &Hdr(i); }
 
     /**
      * Returns whether the header chain indicates a fragmented packet.
@@ -177,7 +178,7 @@ public:
      * Returns pointer to fragment header structure if the chain contains one.
      */
     const struct ip6_frag* GetFragHdr() const {
-        return IsFragment() ? reinterpret_cast<const ip6_frag*>(chain[chain.size() - 1].Data()) : nullptr;
+        return IsFragment() ? reinterpret_cast<const ip6_frag*>(Hdr(num_hdrs - 1).Data()) : nullptr;
     }
 
     /**
@@ -248,7 +249,29 @@ protected:
      */
     void ProcessDstOpts(const struct ip6_dest* d, uint16_t len);
 
-    std::vector<IPv6_Hdr> chain;
+    /**
+     * Appends a header to the chain.
+     */
+    void Append(const IPv6_Hdr& hdr) {
+        if ( num_hdrs < NUM_INLINE_HDRS )
+            inline_hdrs[num_hdrs] = hdr;
+        else
+            extra_hdrs.push_back(hdr);
+
+        ++num_hdrs;
+    }
+
+    const IPv6_Hdr& Hdr(size_t i) const { return i < NUM_INLINE_HDRS ? inline_hdrs[i] : extra_hdrs[i - NUM_INLINE_HDRS]; }
+
+    /**
+     * The headers of the chain. Chains seen in practice are short, so the
+     * first headers are stored inline to avoid allocating memory for every
+     * IPv6 packet; only unusually long chains spill over into extra_hdrs.
+     */
+    static constexpr size_t NUM_INLINE_HDRS = 8;
+    IPv6_Hdr inline_hdrs[NUM_INLINE_HDRS];
+    std::vector<IPv6_Hdr> extra_hdrs;
+    size_t num_hdrs = 0;
 
     /**
      * The summation of all header lengths in the chain in bytes.
@@ -258,13 +281,13 @@ protected:
     /**
      * Home Address of the packet's source as defined by Mobile IPv6 (RFC 6275).
      */
-    IPAddr* homeAddr = nullptr;
+    std::optional<IPAddr> homeAddr;
 
     /**
      * The final destination address in chain's first Routing header that has
      * non-zero segments left.
      */
-    IPAddr* finalDst = nullptr;
+    std::optional<IPAddr> finalDst;
 };
 
 /**
@@ -294,15 +317,20 @@ public:
      * @param arg_del whether to take ownership of \a arg_ip6 pointer's memory.
      * @param len the packet's length in bytes.
      * @param c an already-constructed header chain to take ownership of.
+     * If not given, the chain is built in storage of this object.
      * @param reassembled whether this header is for a reassembled packet.
      */
     IP_Hdr(const ip6_hdr* arg_ip6, bool arg_del, uint64_t len, const IPv6_Hdr_Chain* c = nullptr,
            bool reassembled = false)
-        : ip6(arg_ip6),
-          ip6_hdrs(c ? c : new IPv6_Hdr_Chain(ip6, len)),
-          len(len),
-          del(arg_del),
-          reassembled(reassembled) {}
+        : ip6(arg_ip6), len(len), del(arg_del), reassembled(reassembled) {
+        if ( c )
+            ip6_hdrs = c;
+        else
+            ip6_hdrs = &inline_ip6_hdrs.emplace(ip6, len);
+    }
+
+    IP_Hdr(const IP_Hdr&) = delete;
+    IP_Hdr& operator=(const IP_Hdr&) = delete;
 
     /**
      * Copy a header.  The internal buffer which contains the header data
@@ -315,7 +343,8 @@ public:
      * Destructor.
      */
     ~IP_Hdr() {
-        delete ip6_hdrs;
+        if ( ! inline_ip6_hdrs )
+            delete ip6_hdrs;
 
         if ( del ) {
             delete[] ip4;
@@ -509,6 +538,7 @@ private:
     const ip* ip4 = nullptr;
     const ip6_hdr* ip6 = nullptr;
     const IPv6_Hdr_Chain* ip6_hdrs = nullptr;
+    std::optional<IPv6_Hdr_Chain> inline_ip6_hdrs;
     uint64_t len = 0;
     bool del = false;
     bool reassembled = false;
@@ -6,6 +6,7 @@
 #include <netinet/ip.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <string_view>
 
 #include "zeek/Func.h"
 #include "zeek/IPAddr.h"
@@ -96,6 +97,9 @@ bool MMDB::OpenFile(const std::string& a_filename) {
 }
 
 void MMDB::Close() {
+    cache.clear();
+    cache_index.clear();
+
     if ( IsOpen() ) {
         MMDB_close(&mmdb);
         memset(&mmdb, 0, sizeof(mmdb));
@@ -151,6 +155,50 @@ bool MMDB::Lookup(const zeek::IPAddr& addr, MMDB_lookup_result_s& result) {
     return result.found_entry;
 }
 
+size_t MMDB::AddrHash::operator()(const zeek::IPAddr& addr) const {
+    uint32_t bytes[4];
+    addr.CopyIPv6(bytes);
+    return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(bytes), sizeof(bytes)));
+}
+
+// Copies a cached record. The field values never change and can be shared,
+// but scripts may modify the records they receive.
+static zeek::RecordValPtr copy_record(const zeek::RecordValPtr& rec) {
+    auto copy = zeek::make_intrusive<zeek::RecordVal>(rec->GetType<zeek::RecordType>());
+
+    for ( unsigned int i = 0; i < rec->NumFields(); ++i ) {
+        if ( rec->HasField(i) )
+            copy->Assign(i, rec->GetField(i));
+    }
+
+    return copy;
+}
+
+RecordValPtr MMDB::CacheLookup(const zeek::IPAddr& addr) {
+    auto it = cache_index.find(addr);
+
+    if ( it == cache_index.end() )
+        return nullptr;
+
+    cache.splice(cache.begin(), cache, it->second);
+    return copy_record(it->second->second);
+}
+
+void MMDB::CacheInsert(const zeek::IPAddr& addr, const RecordValPtr& rec) {
+    static zeek_uint_t mmdb_cache_size = zeek::id::find_val("mmdb_cache_size")->AsCount();
+
+    if ( ! IsOpen() || mmdb_cache_size == 0 || cache_index.contains(addr) )
+        return;
+
+    cache.emplace_front(addr, copy_record(rec));
+    cache_index.emplace(addr, cache.begin());
+
+    if ( cache.size() > mmdb_cache_size ) {
+        cache_index.erase(cache.back().first);
+        cache.pop_back();
+    }
+}
+
 // Check to see if the Maxmind DB should be closed and reopened.  This will
 // happen if there was a lookup error or if the mmap'd file has been replaced
 // by an external process.
@@ -264,12 +312,15 @@ ValPtr mmdb_open_asn_db(const StringValPtr& filename) {
 
 RecordValPtr mmdb_lookup_location(const AddrValPtr& addr) {
     static auto geo_location = zeek::id::find_type<zeek::RecordType>("geo_location");
-    auto location = zeek::make_intrusive<zeek::RecordVal>(geo_location);
 
 #ifdef USE_GEOIP
     if ( ! mmdb_loc.EnsureLoaded() )
-        return location;
+        return zeek::make_intrusive<zeek::RecordVal>(geo_location);
 
+    if ( auto cached = mmdb_loc.CacheLookup(addr->AsAddr()) )
+        return cached;
+
+    auto location = zeek::make_intrusive<zeek::RecordVal>(geo_location);
     MMDB_lookup_result_s result;
 
     if ( mmdb_loc.Lookup(addr->AsAddr(), result) ) {
@@ -295,10 +346,12 @@ RecordValPtr mmdb_lookup_location(const AddrValPtr& addr) {
         // Get Location Longitude
         status = MMDB_get_value(&result.entry, &entry_data, "location", "longitude", nullptr);
         location->Assign(4, mmdb_getvalue(&entry_data, status, MMDB_DATA_TYPE_DOUBLE));
-
-        return location;
     }
 
+    // Addresses without information get cached, too.
+    mmdb_loc.CacheInsert(addr->AsAddr(), location);
+    return location;
+
 #else // not USE_GEOIP
     static int missing_geoip_reported = 0;
 
@@ -306,22 +359,22 @@ RecordValPtr mmdb_lookup_location(const AddrValPtr& addr) {
         zeek::emit_builtin_error("Zeek was not configured for GeoIP support");
         missing_geoip_reported = 1;
     }
-#endif
 
-    // We can get here even if we have MMDB support if we weren't
-    // able to initialize it or it didn't return any information for
-    // the address.
-    return location;
+    return zeek::make_intrusive<zeek::RecordVal>(geo_location);
+#endif
 }
 
 RecordValPtr mmdb_lookup_autonomous_system(const AddrValPtr& addr) {
     static auto geo_autonomous_system = zeek::id::find_type<zeek::RecordType>("geo_autonomous_system");
-    auto autonomous_system = zeek::make_intrusive<zeek::RecordVal>(geo_autonomous_system);
 
 #ifdef USE_GEOIP
     if ( ! mmdb_asn.EnsureLoaded() )
-        return autonomous_system;
+        return zeek::make_intrusive<zeek::RecordVal>(geo_autonomous_system);
+
+    if ( auto cached = mmdb_asn.CacheLookup(addr->AsAddr()) )
+        return cached;
 
+    auto autonomous_system = zeek::make_intrusive<zeek::RecordVal>(geo_autonomous_system);
     MMDB_lookup_result_s result;
 
     if ( mmdb_asn.Lookup(addr->AsAddr(), result) ) {
@@ -335,10 +388,12 @@ RecordValPtr mmdb_lookup_autonomous_system(const AddrValPtr& addr) {
         // Get Autonomous System Organization
         status = MMDB_get_value(&result.entry, &entry_data, "autonomous_system_organization", nullptr);
         autonomous_system->Assign(1, mmdb_getvalue(&entry_data, status, MMDB_DATA_TYPE_UTF8_STRING));
-
-        return autonomous_system;
     }
 
+    // Addresses without information get cached, too.
+    mmdb_asn.CacheInsert(addr->AsAddr(), autonomous_system);
+    return autonomous_system;
+
 #else // not USE_GEOIP
     static int missing_geoip_reported = 0;
 
@@ -346,12 +401,34 @@ RecordValPtr mmdb_lookup_autonomous_system(const AddrValPtr& addr) {
         zeek::emit_builtin_error("Zeek was not configured for GeoIP ASN support");
         missing_geoip_reported = 1;
     }
+
+    return zeek::make_intrusive<zeek::RecordVal>(geo_autonomous_system);
 #endif
+}
 
-    // We can get here even if we have GeoIP support, if we weren't
-    // able to initialize it or it didn't return any information for
-    // the address.
-    return autonomous_system;
+// Looks up each address in a vector. Holes in the input vector remain holes
+// in the result.
+static VectorValPtr lookup_all(const VectorValPtr& addrs, const VectorTypePtr& result_type,
+                               RecordValPtr (*lookup)(const AddrValPtr&)) {
+    auto result = zeek::make_intrusive<zeek::VectorVal>(result_type);
+    result->Reserve(addrs->Size());
+
+    for ( unsigned int i = 0; i < addrs->Size(); ++i ) {
+        if ( auto a = addrs->ValAt(i) )
+            result->Assign(i, lookup(zeek::cast_intrusive<zeek::AddrVal>(a)));
+    }
+
+    return result;
+}
+
+VectorValPtr mmdb_lookup_locations(const VectorValPtr& addrs) {
+    static auto geo_location_vec = zeek::id::find_type<zeek::VectorType>("geo_location_vec");
+    return lookup_all(addrs, geo_location_vec, mmdb_lookup_location);
+}
+
+VectorValPtr mmdb_lookup_autonomous_systems(const VectorValPtr& addrs) {
+    static auto geo_autonomous_system_vec = zeek::id::find_type<zeek::VectorType>("geo_autonomous_system_vec");
+    return lookup_all(addrs, geo_autonomous_system_vec, mmdb_lookup_autonomous_system);
 }
 
 } // namespace zeek
@@ -3,7 +3,10 @@
 #pragma once
 
 #include <sys/stat.h>
+#include <list>
+#include <unordered_map>
 
+#include "zeek/IPAddr.h"
 #include "zeek/Val.h"
 
 namespace zeek {
@@ -22,6 +25,10 @@ namespace zeek {
 // The class tracks the inode and modification time of a DB file to detect
 // "stale" DBs, which get reloaded (from the same location in the file system)
 // upon the first lookup that detects staleness.
+//
+// It also keeps an LRU cache of the script-layer records produced for recent
+// lookups, sized via mmdb_cache_size. The cache gets flushed whenever the DB
+// is closed, including when it's reopened because it went stale.
 class MMDB {
 public:
     MMDB();
@@ -60,14 +67,31 @@ public:
     // result structure.
     bool Lookup(const zeek::IPAddr& addr, MMDB_lookup_result_s& result);
 
+    // Returns a copy of the cached record for the given address, or nullptr
+    // if there's none.
+    RecordValPtr CacheLookup(const zeek::IPAddr& addr);
+
+    // Caches the record built for the given address. Does nothing if the DB
+    // isn't open, such as after a failed lookup.
+    void CacheInsert(const zeek::IPAddr& addr, const RecordValPtr& rec);
+
 private:
     bool IsStaleDB();
 
+    struct AddrHash {
+        size_t operator()(const zeek::IPAddr& addr) const;
+    };
+
+    using CacheList = std::list<std::pair<zeek::IPAddr, RecordValPtr>>;
+
     std::string filename;
     MMDB_s mmdb;
     struct stat file_info;
     bool reported_error = false; // to ensure we emit builtin errors during opening only once.
     double last_check;
+
+    CacheList cache;
+    std::unordered_map<zeek::IPAddr, CacheList::iterator, AddrHash> cache_index;
 };
 
 class LocDB : public MMDB {
@@ -90,4 +114,7 @@ ValPtr mmdb_open_asn_db(const StringValPtr& filename);
 RecordValPtr mmdb_lookup_location(const AddrValPtr& addr);
 RecordValPtr mmdb_lookup_autonomous_system(const AddrValPtr& addr);
 
+VectorValPtr mmdb_lookup_locations(const VectorValPtr& addrs);
+VectorValPtr mmdb_lookup_autonomous_systems(const VectorValPtr& addrs);
+
 } // namespace zeek
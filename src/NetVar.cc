@@ -179,6 +179,7 @@ int dpd_max_packets;
 int dpd_match_only_beginning;
 int dpd_late_match_stop;
 int dpd_ignore_ports;
+int dpd_release_buffer_on_confirmation;
 
 int record_all_packets;
 
@@ -325,6 +326,7 @@ void init_net_var() {
     dpd_match_only_beginning = id::find_val("dpd_match_only_beginning")->AsBool();
     dpd_late_match_stop = id::find_val("dpd_late_match_stop")->AsBool();
     dpd_ignore_ports = id::find_val("dpd_ignore_ports")->AsBool();
+    dpd_release_buffer_on_confirmation = id::find_val("dpd_release_buffer_on_confirmation")->AsBool();
 
     tunnel_max_changes_per_connection = id::find_val("Tunnel::max_changes_per_connection")->AsCount();
 }
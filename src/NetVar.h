@@ -89,6 +89,7 @@ ZEEK_EXTERN_DATA int dpd_max_packets;
 ZEEK_EXTERN_DATA int dpd_match_only_beginning;
 ZEEK_EXTERN_DATA int dpd_late_match_stop;
 ZEEK_EXTERN_DATA int dpd_ignore_ports;
+ZEEK_EXTERN_DATA int dpd_release_buffer_on_confirmation;
 
 ZEEK_EXTERN_DATA int record_all_packets;
 
@@ -0,0 +1,252 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/Poptrie.h"
+
+#include <algorithm>
+#include <bit>
+#include <random>
+#include <tuple>
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::detail {
+
+namespace {
+
+constexpr int STRIDE = 6;
+constexpr int SLOTS = 1 << STRIDE;
+constexpr uint64_t SLOT_MASK = SLOTS - 1;
+
+// Returns the STRIDE bits of a key starting at the given bit offset. Bits
+// beyond the end of the key read as zero.
+uint64_t Slot(uint64_t hi, uint64_t lo, int depth) {
+    if ( depth <= 64 - STRIDE )
+        return (hi >> (64 - STRIDE - depth)) & SLOT_MASK;
+
+    if ( depth < 64 )
+        return ((hi << (depth - (64 - STRIDE))) | (lo >> (128 - STRIDE - depth))) & SLOT_MASK;
+
+    depth -= 64;
+
+    if ( depth <= 64 - STRIDE )
+        return (lo >> (64 - STRIDE - depth)) & SLOT_MASK;
+
+    return (lo << (depth - (64 - STRIDE))) & SLOT_MASK;
+}
+
+void MaskPrefix(Poptrie::Prefix* p) {
+    if ( p->width <= 0 ) {
+        p->width = 0;
+        p->hi = p->lo = 0;
+    }
+    else if ( p->width < 64 ) {
+        p->hi &= ~uint64_t(0) << (64 - p->width);
+        p->lo = 0;
+    }
+    else if ( p->width == 64 )
+        p->lo = 0;
+    else if ( p->width < 128 )
+        p->lo &= ~uint64_t(0) << (128 - p->width);
+    else
+        p->width = 128;
+}
+
+} // namespace
+
+void Poptrie::Build(std::vector<Prefix> prefixes, uint32_t default_value) {
+    Clear();
+
+    for ( auto& p : prefixes ) {
+        MaskPrefix(&p);
+
+        // A zero-width prefix covers everything.
+        if ( p.width == 0 )
+            default_value = p.value;
+    }
+
+    std::sort(prefixes.begin(), prefixes.end(), [](const Prefix& a, const Prefix& b) {
+        return std::tie(a.hi, a.lo, a.width) < std::tie(b.hi, b.lo, b.width);
+    });
+
+    nodes.emplace_back();
+    BuildNode(0, 0, prefixes.data(), prefixes.data() + prefixes.size(), default_value);
+
+    nodes.shrink_to_fit();
+    leaves.shrink_to_fit();
+}
+
+void Poptrie::BuildNode(uint32_t node, int depth, const Prefix* begin, const Prefix* end, uint32_t inherited) {
+    // The prefixes given all share the node's first *depth* bits and are
+    // sorted by key. Those not longer than *depth* are already accounted
+    // for in *inherited*.
+    uint32_t best[SLOTS];
+    int best_width[SLOTS];
+    std::fill_n(best, SLOTS, inherited);
+    std::fill_n(best_width, SLOTS, depth);
+
+    // Prefixes ending within this node's stride cover a range of its slots.
+    for ( const auto* p = begin; p != end; ++p ) {
+        if ( p->width <= depth || p->width > depth + STRIDE )
+            continue;
+
+        auto first = Slot(p->hi, p->lo, depth);
+        auto last = first + (uint64_t(1) << (depth + STRIDE - p->width));
+
+        for ( auto s = first; s < last; ++s ) {
+            if ( p->width > best_width[s] ) {
+                best[s] = p->value;
+                best_width[s] = p->width;
+            }
+        }
+    }
+
+    // Longer prefixes continue in child nodes. Since the prefixes are sorted,
+    // those belonging to the same slot are adjacent.
+    struct Child {
+        uint64_t slot;
+        const Prefix* begin;
+        const Prefix* end;
+    };
+
+    Child children[SLOTS];
+    int num_children = 0;
+    uint64_t children_bits = 0;
+
+    for ( const auto* p = begin; p != end; ) {
+        auto slot = Slot(p->hi, p->lo, depth);
+        bool deeper = false;
+        const auto* q = p;
+
+        for ( ; q != end && Slot(q->hi, q->lo, depth) == slot; ++q )
+            deeper = deeper || q->width > depth + STRIDE;
+
+        if ( deeper ) {
+            children[num_children++] = {slot, p, q};
+            children_bits |= uint64_t(1) << slot;
+        }
+
+        p = q;
+    }
+
+    // Leaves are run-length compressed across the slots not taken by
+    // children.
+    uint32_t base_leaves = leaves.size();
+    uint64_t leafvec = 0;
+
+    for ( int s = 0; s < SLOTS; ++s ) {
+        if ( children_bits & (uint64_t(1) << s) )
+            continue;
+
+        if ( leaves.size() == base_leaves || leaves.back() != best[s] ) {
+            leafvec |= uint64_t(1) << s;
+            leaves.push_back(best[s]);
+        }
+    }
+
+    uint32_t base_children = nodes.size();
+    nodes.resize(nodes.size() + num_children);
+    nodes[node] = {children_bits, leafvec, base_leaves, base_children};
+
+    for ( int i = 0; i < num_children; ++i )
+        BuildNode(base_children + i, depth + STRIDE, children[i].begin, children[i].end, best[children[i].slot]);
+}
+
+uint32_t Poptrie::Lookup(uint64_t hi, uint64_t lo) const {
+    const Node* n = nodes.data();
+    int depth = 0;
+
+    while ( true ) {
+        auto slot = Slot(hi, lo, depth);
+        auto upto = (uint64_t(2) << slot) - 1;
+
+        if ( ! (n->children & (uint64_t(1) << slot)) )
+            return leaves[n->base_leaves + std::popcount(n->leafvec & upto) - 1];
+
+        n = &nodes[n->base_children + std::popcount(n->children & upto) - 1];
+        depth += STRIDE;
+    }
+}
+
+void Poptrie::Clear() {
+    nodes.clear();
+    nodes.shrink_to_fit();
+    leaves.clear();
+    leaves.shrink_to_fit();
+}
+
+} // namespace zeek::detail
+
+TEST_SUITE_BEGIN("poptrie");
+
+namespace {
+
+using zeek::detail::Poptrie;
+
+bool Matches(const Poptrie::Prefix& p, uint64_t hi, uint64_t lo) {
+    uint64_t mask_hi = p.width >= 64 ? ~uint64_t(0) : p.width == 0 ? 0 : ~uint64_t(0) << (64 - p.width);
+    uint64_t mask_lo = p.width >= 128 ? ~uint64_t(0) : p.width <= 64 ? 0 : ~uint64_t(0) << (128 - p.width);
+    return (hi & mask_hi) == (p.hi & mask_hi) && (lo & mask_lo) == (p.lo & mask_lo);
+}
+
+uint32_t BruteForceLookup(const std::vector<Poptrie::Prefix>& prefixes, uint64_t hi, uint64_t lo) {
+    uint32_t value = 0;
+    int width = -1;
+
+    for ( const auto& p : prefixes ) {
+        if ( p.width > width && Matches(p, hi, lo) ) {
+            value = p.value;
+            width = p.width;
+        }
+    }
+
+    return value;
+}
+
+} // namespace
+
+TEST_CASE("empty") {
+    Poptrie t;
+    t.Build({}, 7);
+    CHECK(t.Lookup(0, 0) == 7);
+    CHECK(t.Lookup(~uint64_t(0), ~uint64_t(0)) == 7);
+}
+
+TEST_CASE("matches brute force") {
+    std::mt19937_64 rng(4711);
+    std::vector<Poptrie::Prefix> prefixes;
+
+    // A few common bases, so that prefixes nest.
+    uint64_t bases[] = {0, 0x20010db800000000, 0x0000000000000000, rng()};
+    uint64_t lo_bases[] = {0x0000ffff0a000000, 0, rng(), rng()};
+    int widths[] = {0, 1, 5, 6, 7, 8, 12, 16, 24, 32, 48, 63, 64, 65, 96, 104, 112, 120, 126, 127, 128};
+
+    for ( uint32_t i = 1; i <= 3000; ++i ) {
+        auto b = rng() % 4;
+        int width = widths[rng() % std::size(widths)];
+        uint64_t hi = bases[b] ^ (rng() & rng() & rng());
+        uint64_t lo = lo_bases[b] ^ (rng() & rng());
+
+        // Skip duplicates, for which the winner is unspecified.
+        auto dup = [&](const Poptrie::Prefix& p) { return p.width == width && Matches(p, hi, lo); };
+        if ( std::none_of(prefixes.begin(), prefixes.end(), dup) )
+            prefixes.push_back({hi, lo, width, i});
+    }
+
+    Poptrie t;
+    t.Build(prefixes);
+
+    for ( const auto& p : prefixes ) {
+        uint64_t hi = p.hi ^ (rng() & rng() & rng() & 0xff);
+        uint64_t lo = p.lo ^ (rng() & rng());
+        CHECK(t.Lookup(p.hi, p.lo) == BruteForceLookup(prefixes, p.hi, p.lo));
+        CHECK(t.Lookup(hi, lo) == BruteForceLookup(prefixes, hi, lo));
+    }
+
+    for ( int i = 0; i < 1000; ++i ) {
+        uint64_t hi = rng();
+        uint64_t lo = rng();
+        CHECK(t.Lookup(hi, lo) == BruteForceLookup(prefixes, hi, lo));
+    }
+}
+
+TEST_SUITE_END();
@@ -0,0 +1,79 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * A static longest-prefix-match structure for keys of up to 128 bits,
+ * following the poptrie design (Asai and Ohara, SIGCOMM 2015). Every node
+ * covers six bits of the key and keeps two 64-bit bitmaps: one marking the
+ * slots that continue in a child node, and one marking where runs of
+ * identical leaves start. Children and leaves of a node are stored
+ * contiguously, so a lookup step is a popcount plus one array access, and
+ * the whole structure lives in two flat arrays.
+ *
+ * A poptrie can't be modified after it has been built; users rebuild it
+ * from scratch when their set of prefixes changes.
+ */
+class Poptrie {
+public:
+    /**
+     * A prefix to build the trie from. The key's bits are numbered from the
+     * most significant bit of *hi* to the least significant bit of *lo*.
+     */
+    struct Prefix {
+        uint64_t hi;
+        uint64_t lo;
+        int width;
+        uint32_t value;
+    };
+
+    /**
+     * Replaces the trie's content.
+     *
+     * @param prefixes The prefixes to insert. Bits beyond a prefix's width
+     * are ignored. For duplicate prefixes, an arbitrary one wins.
+     *
+     * @param default_value The value to return for keys that no prefix
+     * covers.
+     */
+    void Build(std::vector<Prefix> prefixes, uint32_t default_value = 0);
+
+    /**
+     * Returns the value of the longest prefix matching a key, or the default
+     * value if there is none. Must only be called after Build().
+     */
+    uint32_t Lookup(uint64_t hi, uint64_t lo) const;
+
+    /**
+     * Releases the trie's memory.
+     */
+    void Clear();
+
+    /**
+     * Returns the number of bytes allocated for the trie.
+     */
+    size_t MemoryAllocation() const {
+        return nodes.capacity() * sizeof(Node) + leaves.capacity() * sizeof(uint32_t);
+    }
+
+private:
+    struct Node {
+        uint64_t children; // Slots that continue in a child node.
+        uint64_t leafvec;  // Slots starting a new run of leaves.
+        uint32_t base_leaves;
+        uint32_t base_children;
+    };
+
+    void BuildNode(uint32_t node, int depth, const Prefix* begin, const Prefix* end, uint32_t inherited);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> leaves;
+};
+
+} // namespace zeek::detail
@@ -2,9 +2,13 @@
 
 #include "zeek/PrefixTable.h"
 
+#include <algorithm>
+
 #include "zeek/Reporter.h"
 #include "zeek/Val.h"
 
+#include "zeek/3rdparty/doctest.h"
+
 namespace zeek::detail {
 
 prefix_t* PrefixTable::MakePrefix(const IPAddr& addr, int width) {
@@ -35,6 +39,10 @@ void* PrefixTable::Insert(const IPAddr& addr, int width, void* data) {
 
     void* old = node->data;
 
+    // A new prefix changes the trie's structure.
+    if ( ! old )
+        InvalidateIndex();
+
     // If there is no data to be associated with addr, we take the
     // node itself.
     node->data = data ? data : node;
@@ -83,6 +91,15 @@ std::list<std::tuple<IPPrefix, void*>> PrefixTable::FindAll(const SubNetVal* val
 }
 
 void* PrefixTable::Lookup(const IPAddr& addr, int width, bool exact) const {
+    if ( ! exact && width == 128 ) {
+        if ( ! index_valid && ++lookups_without_index >=
+                                  std::max(MIN_LOOKUPS_BEFORE_INDEX, static_cast<uint64_t>(tree->num_active_node)) )
+            BuildIndex();
+
+        if ( index_valid )
+            return IndexLookup(addr);
+    }
+
     prefix_t* prefix = MakePrefix(addr, width);
     patricia_node_t* node = exact ? patricia_search_exact(tree, prefix) : patricia_search_best(tree, prefix);
 
@@ -118,6 +135,7 @@ void* PrefixTable::Remove(const IPAddr& addr, int width) {
         return nullptr;
 
     void* old = node->data;
+    InvalidateIndex();
     patricia_remove(tree, node);
 
     return old;
@@ -137,6 +155,99 @@ void* PrefixTable::Remove(const Val* value) {
     }
 }
 
+void* PrefixTable::IndexLookup(const IPAddr& addr) const {
+    uint32_t w[4];
+    addr.CopyIPv6(w, IPAddr::Host);
+
+    uint32_t i;
+
+    if ( addr.GetFamily() == IPv4 )
+        i = v4_index.Lookup(static_cast<uint64_t>(w[3]) << 32, 0);
+    else
+        i = v6_index.Lookup((static_cast<uint64_t>(w[0]) << 32) | w[1], (static_cast<uint64_t>(w[2]) << 32) | w[3]);
+
+    return i ? index_nodes[i - 1]->data : nullptr;
+}
+
+void PrefixTable::BuildIndex() const {
+    // IPv4 addresses live below ::ffff:0:0/96. Prefixes within that range go
+    // into a separate index keyed by the IPv4 address alone, so that their
+    // lookups don't need to walk down the 96 common bits first. Shorter
+    // prefixes that cover the whole range provide that index's default.
+    constexpr uint64_t v4_mapped_lo = 0x0000ffff00000000;
+
+    std::vector<Poptrie::Prefix> v4_prefixes;
+    std::vector<Poptrie::Prefix> v6_prefixes;
+    uint32_t v4_default = 0;
+    int v4_default_width = -1;
+
+    index_nodes.clear();
+
+    std::vector<patricia_node_t*> stack;
+
+    if ( tree->head )
+        stack.push_back(tree->head);
+
+    while ( ! stack.empty() ) {
+        auto* node = stack.back();
+        stack.pop_back();
+
+        if ( node->l )
+            stack.push_back(node->l);
+
+        if ( node->r )
+            stack.push_back(node->r);
+
+        if ( ! node->prefix )
+            continue;
+
+        const auto* b = reinterpret_cast<const uint8_t*>(&node->prefix->add.sin6);
+        uint64_t hi = 0;
+        uint64_t lo = 0;
+
+        for ( int i = 0; i < 8; ++i ) {
+            hi = (hi << 8) | b[i];
+            lo = (lo << 8) | b[i + 8];
+        }
+
+        int width = node->prefix->bitlen;
+        index_nodes.push_back(node);
+        uint32_t value = index_nodes.size();
+
+        if ( width >= 96 && hi == 0 && (lo >> 32) == (v4_mapped_lo >> 32) ) {
+            v4_prefixes.push_back({lo << 32, 0, width - 96, value});
+            continue;
+        }
+
+        v6_prefixes.push_back({hi, lo, width, value});
+
+        uint64_t mask_hi = width >= 64 ? ~uint64_t(0) : width == 0 ? 0 : ~uint64_t(0) << (64 - width);
+        uint64_t mask_lo = width <= 64 ? 0 : ~uint64_t(0) << (128 - width);
+
+        if ( (hi & mask_hi) == 0 && (lo & mask_lo) == (v4_mapped_lo & mask_lo) && width > v4_default_width ) {
+            v4_default = value;
+            v4_default_width = width;
+        }
+    }
+
+    v4_index.Build(std::move(v4_prefixes), v4_default);
+    v6_index.Build(std::move(v6_prefixes));
+    index_valid = true;
+}
+
+void PrefixTable::InvalidateIndex() {
+    lookups_without_index = 0;
+
+    if ( ! index_valid )
+        return;
+
+    v4_index.Clear();
+    v6_index.Clear();
+    index_nodes.clear();
+    index_nodes.shrink_to_fit();
+    index_valid = false;
+}
+
 PrefixTable::iterator PrefixTable::InitIterator() {
     iterator i = {};
     i.Xsp = i.Xstack;
@@ -175,3 +286,71 @@ void* PrefixTable::GetNext(iterator* i) {
 }
 
 } // namespace zeek::detail
+
+TEST_SUITE_BEGIN("prefix table");
+
+TEST_CASE("indexed lookups") {
+    using zeek::IPAddr;
+    using zeek::IPPrefix;
+
+    zeek::detail::PrefixTable pt;
+    std::vector<std::pair<IPPrefix, void*>> prefixes;
+
+    auto insert = [&](const char* s) {
+        IPPrefix p;
+        REQUIRE(IPPrefix::ConvertString(s, &p));
+        auto* data = reinterpret_cast<void*>(prefixes.size() + 1);
+        pt.Insert(p.Prefix(), p.LengthIPv6(), data);
+        prefixes.emplace_back(p, data);
+    };
+
+    auto expected = [&](const IPAddr& a) {
+        void* best = nullptr;
+        int best_len = -1;
+
+        for ( const auto& [p, data] : prefixes ) {
+            if ( data && p.Contains(a) && p.LengthIPv6() > best_len ) {
+                best = data;
+                best_len = p.LengthIPv6();
+            }
+        }
+
+        return best;
+    };
+
+    for ( const char* s : {"10.0.0.0/8", "10.1.0.0/16", "10.1.2.0/24", "10.1.2.3/32", "192.168.0.0/16", "2001:db8::/32",
+                           "2001:db8:1::/48", "2001:db8:1::1/128", "::ffff:0:0/80", "fe80::/10"} )
+        insert(s);
+
+    std::vector<IPAddr> addrs;
+
+    for ( const char* s : {"10.0.0.1", "10.1.0.1", "10.1.2.1", "10.1.2.3", "10.1.2.4", "11.0.0.1", "192.168.1.1",
+                           "192.169.0.0", "2001:db8::1", "2001:db8:1::1", "2001:db8:1::2", "2001:db9::1", "fe80::1",
+                           "::1", "1.2.3.4"} )
+        addrs.emplace_back(s);
+
+    // The first rounds of lookups go to the patricia trie, later ones to the
+    // index.
+    for ( int round = 0; round < 20; ++round ) {
+        for ( const auto& a : addrs )
+            CHECK(pt.Lookup(a, 128) == expected(a));
+    }
+
+    // Updating the data of an existing prefix.
+    prefixes[2].second = reinterpret_cast<void*>(100);
+    pt.Insert(prefixes[2].first.Prefix(), prefixes[2].first.LengthIPv6(), prefixes[2].second);
+    CHECK(pt.Lookup(IPAddr("10.1.2.1"), 128) == prefixes[2].second);
+
+    // Structural changes, including a default route for IPv4 and IPv6.
+    insert("0.0.0.0/0");
+    pt.Remove(prefixes[3].first.Prefix(), prefixes[3].first.LengthIPv6());
+    prefixes[3].second = nullptr;
+    insert("::/0");
+
+    for ( int round = 0; round < 20; ++round ) {
+        for ( const auto& a : addrs )
+            CHECK(pt.Lookup(a, 128) == expected(a));
+    }
+}
+
+TEST_SUITE_END();
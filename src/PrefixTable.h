@@ -8,8 +8,10 @@ extern "C" {
 
 #include <list>
 #include <tuple>
+#include <vector>
 
 #include "zeek/IPAddr.h"
+#include "zeek/Poptrie.h"
 
 namespace zeek {
 
@@ -56,7 +58,10 @@ public:
     void* Remove(const IPAddr& addr, int width);
     void* Remove(const Val* value);
 
-    void Clear() { Clear_Patricia(tree, delete_function); }
+    void Clear() {
+        InvalidateIndex();
+        Clear_Patricia(tree, delete_function);
+    }
 
     // Sets a function to call for each node when table is cleared/destroyed.
     void SetDeleteFunction(data_fn_t del_fn) { delete_function = del_fn; }
@@ -68,8 +73,26 @@ private:
     static prefix_t* MakePrefix(const IPAddr& addr, int width);
     static IPPrefix PrefixToIPPrefix(prefix_t* p);
 
+    // Longest-prefix matches of individual addresses are answered from a
+    // poptrie index once the table has been looked up more often than it
+    // has entries since its last structural change. The index refers to the
+    // trie's nodes, so updating the data of an existing prefix keeps it
+    // valid, but adding or removing prefixes drops it.
+    void* IndexLookup(const IPAddr& addr) const;
+    void BuildIndex() const;
+    void InvalidateIndex();
+
+    // Lookups to see at least before building the index.
+    static constexpr uint64_t MIN_LOOKUPS_BEFORE_INDEX = 128;
+
     patricia_tree_t* tree;
     data_fn_t delete_function;
+
+    mutable Poptrie v4_index; // IPv4 addresses.
+    mutable Poptrie v6_index; // All other addresses.
+    mutable std::vector<patricia_node_t*> index_nodes;
+    mutable bool index_valid = false;
+    mutable uint64_t lookups_without_index = 0;
 };
 
 } // namespace detail
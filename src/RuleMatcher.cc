@@ -216,6 +216,7 @@ RuleMatcher::RuleMatcher(int arg_RE_level) {
     RE_level = arg_RE_level;
     parse_error = false;
     has_non_file_magic_rule = false;
+    has_http_body_rule = false;
 }
 
 RuleMatcher::~RuleMatcher() {
@@ -364,6 +365,11 @@ void RuleMatcher::BuildRulesTree() {
             }
         }
 
+        for ( const auto& p : pats ) {
+            if ( p->type == Rule::HTTP_REQUEST_BODY || p->type == Rule::HTTP_REPLY_BODY )
+                has_http_body_rule = true;
+        }
+
         rule->SortHdrTests();
         InsertRuleIntoTree(rule, 0, root, 0);
     }
@@ -316,6 +316,9 @@ public:
 
     bool HasNonFileMagicRule() const { return has_non_file_magic_rule; }
 
+    // Returns true if any rule matches on HTTP request or reply bodies.
+    bool HasHTTPBodyRule() const { return has_http_body_rule; }
+
     // Interface to for getting some statistics
     struct Stats {
         unsigned int matchers; // # distinct RE matchers
@@ -380,6 +383,7 @@ private:
 
     int RE_level;
     bool has_non_file_magic_rule;
+    bool has_http_body_rule;
     bool parse_error;
     RuleHdrTest* root;
     rule_list rules;
@@ -2,10 +2,15 @@
 
 #include "zeek/TunnelEncapsulation.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 #include "zeek/Conn.h"
 #include "zeek/Reporter.h"
 #include "zeek/util.h"
 
+#include "zeek/3rdparty/doctest.h"
+
 namespace zeek {
 
 EncapsulatingConn::EncapsulatingConn(Connection* c, BifEnum::Tunnel::Type t)
@@ -58,6 +63,64 @@ bool operator==(const EncapsulationStack& e1, const EncapsulationStack& e2) {
     return true;
 }
 
+namespace {
+
+struct StackPool {
+    std::unordered_multimap<size_t, std::weak_ptr<EncapsulationStack>> stacks;
+    size_t sweep_at = 64;
+};
+
+} // namespace
+
+std::shared_ptr<EncapsulationStack> EncapsulationStack::Intern(const std::shared_ptr<EncapsulationStack>& stack) {
+    if ( ! stack )
+        return nullptr;
+
+    static StackPool pool;
+
+    auto h = stack->Hash();
+    auto [it, end] = pool.stacks.equal_range(h);
+
+    while ( it != end ) {
+        if ( auto s = it->second.lock() ) {
+            if ( *s == *stack )
+                return s;
+
+            ++it;
+        }
+        else
+            it = pool.stacks.erase(it);
+    }
+
+    // Stacks go away without telling the pool, so sweep out the stale
+    // entries whenever the pool has doubled in size.
+    if ( pool.stacks.size() >= pool.sweep_at ) {
+        std::erase_if(pool.stacks, [](const auto& e) { return e.second.expired(); });
+        pool.sweep_at = std::max(size_t(64), 2 * pool.stacks.size());
+    }
+
+    auto s = std::make_shared<EncapsulationStack>(*stack);
+
+    if ( s->conns ) {
+        for ( auto& c : *s->conns )
+            c.ip_hdr.reset();
+    }
+
+    pool.stacks.emplace(h, s);
+    return s;
+}
+
+size_t EncapsulationStack::Hash() const {
+    size_t h = Depth();
+
+    if ( conns ) {
+        for ( const auto& c : *conns )
+            h = h * 31 + c.Hash();
+    }
+
+    return h;
+}
+
 void EncapsulationStack::Pop() {
     if ( Depth() == 0 ) {
         reporter->InternalWarning("Attempted to pop from empty EncapsulationStack\n");
@@ -68,3 +131,33 @@ void EncapsulationStack::Pop() {
 }
 
 } // namespace zeek
+
+TEST_SUITE_BEGIN("encapsulation stack");
+
+TEST_CASE("interning") {
+    using zeek::EncapsulationStack;
+
+    zeek::EncapsulatingConn ec(zeek::IPAddr("10.0.0.1"), zeek::IPAddr("10.0.0.2"));
+    ec.ip_hdr = std::make_shared<zeek::IP_Hdr>(nullptr, false);
+
+    auto s1 = std::make_shared<EncapsulationStack>();
+    s1->Add(ec);
+    auto s2 = std::make_shared<EncapsulationStack>(*s1);
+
+    auto i1 = EncapsulationStack::Intern(s1);
+    auto i2 = EncapsulationStack::Intern(s2);
+    CHECK(i1 != s1);
+    CHECK(i1 == i2);
+    CHECK(*i1 == *s1);
+    CHECK_FALSE(i1->Last()->ip_hdr);
+    CHECK(s1->Last()->ip_hdr);
+
+    s2->Add(ec);
+    auto i3 = EncapsulationStack::Intern(s2);
+    CHECK(i3 != i1);
+    CHECK(i3->Depth() == 2);
+
+    CHECK_FALSE(EncapsulationStack::Intern(nullptr));
+}
+
+TEST_SUITE_END();
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "zeek/IP.h"
@@ -103,6 +104,11 @@ public:
 
     friend bool operator!=(const EncapsulatingConn& ec1, const EncapsulatingConn& ec2) { return ! (ec1 == ec2); }
 
+    /**
+     * Returns a hash of the tunnel, consistent with the equality operator.
+     */
+    size_t Hash() const { return uid.Hash() ^ type; }
+
     // TODO: temporarily public
     std::shared_ptr<IP_Hdr> ip_hdr;
 
@@ -191,6 +197,11 @@ public:
 
     friend bool operator!=(const EncapsulationStack& e1, const EncapsulationStack& e2) { return ! (e1 == e2); }
 
+    /**
+     * Returns a hash of the stack, consistent with the equality operator.
+     */
+    size_t Hash() const;
+
     /**
      * Returns a pointer the last element in the stack. Returns a nullptr
      * if the stack is empty or hasn't been initialized yet.
@@ -217,6 +228,26 @@ public:
      */
     void Pop();
 
+    /**
+     * Returns a shared, immutable copy of an encapsulation stack. All
+     * callers passing equal stacks receive the same copy for as long as
+     * any of them holds on to it, so that connections inside the same
+     * tunnel don't each keep their own. The copy doesn't retain the
+     * tunnels' IP headers.
+     *
+     * @param stack The stack to copy.
+     * @return The shared copy, or nullptr if \a stack is nullptr.
+     */
+    static std::shared_ptr<EncapsulationStack> Intern(const std::shared_ptr<EncapsulationStack>& stack);
+
+    /**
+     * Returns the number of bytes allocated for the stack, including the
+     * object itself.
+     */
+    size_t MemoryAllocation() const {
+        return sizeof(*this) + (conns ? sizeof(*conns) + conns->capacity() * sizeof(EncapsulatingConn) : 0);
+    }
+
 protected:
     std::vector<EncapsulatingConn>* conns = nullptr;
 };
@@ -81,6 +81,11 @@ public:
      */
     friend bool operator!=(const UID& u1, const UID& u2) { return ! (u1 == u2); }
 
+    /**
+     * Returns a hash of the UID, consistent with the equality operator.
+     */
+    size_t Hash() const { return (uid[0] * 0x9e3779b97f4a7c15) ^ uid[1]; }
+
 private:
     uint64_t uid[UID_LEN];
     bool initialized; // Since technically uid == 0 is a legit UID
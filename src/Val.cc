@@ -2128,20 +2128,16 @@ const ValPtr& TableVal::Find(const ValPtr& index) {
     }
 
     if ( table_val->Length() > 0 ) {
-        auto k = MakeHashKey(*index);
+        TableEntryVal* v = LookupEntry(*index);
 
-        if ( k ) {
-            TableEntryVal* v = table_val->Lookup(k.get());
-
-            if ( v ) {
-                if ( attrs && attrs->Find(detail::ATTR_EXPIRE_READ) )
-                    v->SetExpireAccess(run_state::network_time);
+        if ( v ) {
+            if ( attrs && attrs->Find(detail::ATTR_EXPIRE_READ) )
+                v->SetExpireAccess(run_state::network_time);
 
-                if ( v->GetVal() )
-                    return v->GetVal();
+            if ( v->GetVal() )
+                return v->GetVal();
 
-                return val_mgr->True();
-            }
+            return val_mgr->True();
         }
     }
 
@@ -2236,14 +2232,8 @@ bool TableVal::UpdateTimestamp(Val* index) {
 
     if ( subnets )
         v = reinterpret_cast<TableEntryVal*>(subnets->Lookup(index));
-    else {
-        auto k = MakeHashKey(*index);
-
-        if ( ! k )
-            return false;
-
-        v = table_val->Lookup(k.get());
-    }
+    else
+        v = LookupEntry(*index);
 
     if ( ! v )
         return false;
@@ -2930,6 +2920,27 @@ std::unique_ptr<detail::HashKey> TableVal::MakeHashKey(const Val& index) const {
     return GetTableHash()->MakeHashKey(index, true);
 }
 
+// Fixed-layout keys up to this size get built on the stack for lookups.
+// That covers indices of up to eight addresses or counts.
+constexpr size_t MAX_STACK_KEY_SIZE = 128;
+
+TableEntryVal* TableVal::LookupEntry(const Val& index) const {
+    const auto* th = GetTableHash();
+
+    if ( auto key_size = th->FixedKeySize(); key_size > 0 && key_size <= MAX_STACK_KEY_SIZE ) {
+        alignas(double) char buf[MAX_STACK_KEY_SIZE];
+
+        if ( ! th->WriteFixedKey(index, true, buf) )
+            return nullptr;
+
+        return table_val->Lookup(buf, key_size, detail::HashKey::HashBytes(buf, key_size));
+    }
+
+    auto k = MakeHashKey(index);
+
+    return k ? table_val->Lookup(k.get()) : nullptr;
+}
+
 void TableVal::SaveParseTimeTableState(RecordType* rt) {
     auto it = parse_time_table_record_dependencies.find(rt);
 
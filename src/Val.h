@@ -1075,6 +1075,10 @@ protected:
     // Sends data on to backing Broker Store
     void SendToStore(const Val* index, const TableEntryVal* new_entry_val, OnChangeType type);
 
+    // Looks up the entry for the given index, if any. For index types
+    // with a fixed layout, builds the key on the stack.
+    TableEntryVal* LookupEntry(const Val& index) const;
+
     unsigned int ComputeFootprint(std::unordered_set<const Val*>* analyzed_vals) const override;
 
     ValPtr DoClone(CloneState* state) override;
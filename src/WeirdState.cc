@@ -2,12 +2,17 @@
 
 #include "zeek/WeirdState.h"
 
+#include <vector>
+
 #include "zeek/RunState.h"
 
+#include "zeek/3rdparty/doctest.h"
+
 namespace zeek::detail {
 
-bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold, uint64_t rate, double duration) {
-    auto& state = wsm[name];
+namespace {
+
+bool Permit(WeirdState& state, uint64_t threshold, uint64_t rate, double duration) {
     ++state.count;
 
     if ( state.count <= threshold )
@@ -30,4 +35,90 @@ bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold, uint6
         return false;
 }
 
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+};
+
+} // namespace
+
+bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold, uint64_t rate, double duration) {
+    return Permit(wsm[name], threshold, rate, duration);
+}
+
+uint32_t InternWeirdName(std::string_view name) {
+    static std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>> names;
+
+    if ( auto it = names.find(name); it != names.end() )
+        return it->second;
+
+    uint32_t id = names.size();
+    names.emplace(name, id);
+    return id;
+}
+
+WeirdState& CompactWeirdStateMap::operator[](std::string_view name) {
+    auto id = InternWeirdName(name);
+
+    for ( uint8_t i = 0; i < num_inline; ++i ) {
+        if ( ids[i] == id )
+            return states[i];
+    }
+
+    if ( num_inline < INLINE_STATES ) {
+        ids[num_inline] = id;
+        states[num_inline] = {};
+        return states[num_inline++];
+    }
+
+    if ( ! overflow )
+        overflow = std::make_unique<std::unordered_map<uint32_t, WeirdState>>();
+
+    return (*overflow)[id];
+}
+
+size_t CompactWeirdStateMap::MemoryAllocation() const {
+    size_t size = sizeof(*this);
+
+    if ( overflow )
+        // An approximation, the node layout is up to the implementation.
+        size += sizeof(*overflow) + overflow->bucket_count() * sizeof(void*) +
+                overflow->size() * (sizeof(std::pair<const uint32_t, WeirdState>) + 2 * sizeof(void*));
+
+    return size;
+}
+
+bool PermitWeird(CompactWeirdStateMap& wsm, const char* name, uint64_t threshold, uint64_t rate, double duration) {
+    return Permit(wsm[name], threshold, rate, duration);
+}
+
 } // namespace zeek::detail
+
+TEST_SUITE_BEGIN("weird state");
+
+TEST_CASE("interned names") {
+    using zeek::detail::InternWeirdName;
+
+    auto a = InternWeirdName("weird_state_test_a");
+    auto b = InternWeirdName("weird_state_test_b");
+    CHECK(a != b);
+    CHECK(InternWeirdName(std::string("weird_state_test_a")) == a);
+}
+
+TEST_CASE("compact map") {
+    zeek::detail::CompactWeirdStateMap wsm;
+    std::vector<std::string> names;
+
+    for ( int i = 0; i < 10; ++i )
+        names.push_back("weird_state_test_" + std::to_string(i));
+
+    for ( int round = 1; round <= 3; ++round ) {
+        for ( const auto& n : names )
+            CHECK(++wsm[n].count == static_cast<uint64_t>(round));
+    }
+
+    CHECK(wsm.Size() == names.size());
+    CHECK(wsm.MemoryAllocation() > sizeof(wsm));
+}
+
+TEST_SUITE_END();
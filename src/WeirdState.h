@@ -3,7 +3,9 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 namespace zeek::detail {
@@ -18,4 +20,44 @@ using WeirdStateMap = std::unordered_map<std::string, WeirdState>;
 
 bool PermitWeird(WeirdStateMap& wsm, const char* name, uint64_t threshold, uint64_t rate, double duration);
 
+/**
+ * Returns a small integer identifying a weird name. Calls with the same name
+ * always return the same value.
+ */
+uint32_t InternWeirdName(std::string_view name);
+
+/**
+ * Weird state for the few distinct weirds that most connections see, kept
+ * inline and identified by interned name rather than by string. States for
+ * weirds beyond the inline ones go into a map allocated on demand.
+ */
+class CompactWeirdStateMap {
+public:
+    /**
+     * Returns the state for a weird, creating it if necessary.
+     */
+    WeirdState& operator[](std::string_view name);
+
+    /**
+     * Returns the number of weirds tracked.
+     */
+    size_t Size() const { return num_inline + (overflow ? overflow->size() : 0); }
+
+    /**
+     * Returns the number of bytes allocated for the states, including the
+     * object itself.
+     */
+    size_t MemoryAllocation() const;
+
+private:
+    static constexpr uint8_t INLINE_STATES = 4;
+
+    uint32_t ids[INLINE_STATES];
+    WeirdState states[INLINE_STATES];
+    uint8_t num_inline = 0;
+    std::unique_ptr<std::unordered_map<uint32_t, WeirdState>> overflow;
+};
+
+bool PermitWeird(CompactWeirdStateMap& wsm, const char* name, uint64_t threshold, uint64_t rate, double duration);
+
 } // namespace zeek::detail
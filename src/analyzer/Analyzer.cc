@@ -8,7 +8,9 @@
 
 #include "zeek/Conn.h"
 #include "zeek/Event.h"
+#include "zeek/NetVar.h"
 #include "zeek/analyzer/Manager.h"
+#include "zeek/analyzer/protocol/pia/PIA.h"
 #include "zeek/packet_analysis/protocol/ip/conn_key/IPBasedConnKey.h"
 #include "zeek/packet_analysis/protocol/tcp/TCPSessionAdapter.h"
 
@@ -178,6 +180,10 @@ void Analyzer::NextPacket(int len, const u_char* data, bool is_orig, uint64_t se
     if ( skip )
         return;
 
+    // Whatever the analyzer does with the data may show in the
+    // connection record.
+    conn->InvalidateVal();
+
     SupportAnalyzer* next_sibling = FirstSupportAnalyzer(is_orig);
 
     if ( next_sibling )
@@ -196,6 +202,8 @@ void Analyzer::NextStream(int len, const u_char* data, bool is_orig) {
     if ( skip )
         return;
 
+    conn->InvalidateVal();
+
     SupportAnalyzer* next_sibling = FirstSupportAnalyzer(is_orig);
 
     if ( next_sibling )
@@ -214,6 +222,8 @@ void Analyzer::NextUndelivered(uint64_t seq, int len, bool is_orig) {
     if ( skip )
         return;
 
+    conn->InvalidateVal();
+
     SupportAnalyzer* next_sibling = FirstSupportAnalyzer(is_orig);
 
     if ( next_sibling )
@@ -232,6 +242,8 @@ void Analyzer::NextEndOfData(bool is_orig) {
     if ( skip )
         return;
 
+    conn->InvalidateVal();
+
     SupportAnalyzer* next_sibling = FirstSupportAnalyzer(is_orig);
 
     if ( next_sibling )
@@ -359,6 +371,7 @@ bool Analyzer::AddChildAnalyzer(Analyzer* analyzer, bool init) {
 
     analyzer->parent = this;
     new_children.push_back(analyzer);
+    conn->InvalidateVal();
 
     if ( init )
         analyzer->Init();
@@ -644,6 +657,14 @@ void Analyzer::AnalyzerConfirmation(zeek::Tag arg_tag) {
 
     analyzer_confirmed = true;
 
+    // Once a top-level analyzer knows what it's looking at, there's
+    // no more need to keep input around for others.
+    if ( zeek::detail::dpd_release_buffer_on_confirmation && conn && Parent() &&
+         Parent() == conn->GetSessionAdapter() ) {
+        if ( auto* pia = conn->GetPrimaryPIA() )
+            pia->StopBuffering();
+    }
+
     const auto& effective_tag = arg_tag ? arg_tag : tag;
 
     if ( analyzer_confirmation_info )
@@ -639,6 +639,17 @@ public:
         return EnqueueConnEvent(h, zeek::Args{std::forward<Args>(args)...});
     }
 
+    /**
+     * A version of EnqueueConnEvent() that only builds the argument list,
+     * such as the connection's record value, if the event has any handlers.
+     */
+    template<class F>
+        requires std::is_invocable_r_v<zeek::Args, F>
+    void EnqueueConnEvent(EventHandlerPtr h, F&& make_args) {
+        if ( h )
+            EnqueueConnEvent(h, std::forward<F>(make_args)());
+    }
+
     /**
      * Convenience function that forwards directly to the corresponding
      * Connection::Weird().
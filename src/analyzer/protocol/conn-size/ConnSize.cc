@@ -8,6 +8,7 @@
 #include "zeek/Reporter.h"
 #include "zeek/RunState.h"
 #include "zeek/analyzer/protocol/conn-size/events.bif.h"
+#include "zeek/packet_analysis/Manager.h"
 
 namespace zeek::analyzer::conn_size {
 
@@ -34,7 +35,13 @@ void ConnSize_Analyzer::Init() {
         NextGenericPacketThreshold();
 }
 
-void ConnSize_Analyzer::Done() { Analyzer::Done(); }
+void ConnSize_Analyzer::Done() {
+    // Shunted packets get handed to us directly.
+    if ( auto& shunt_table = packet_mgr->GetShuntTable(); shunt_table.IsShunted(Conn()) )
+        shunt_table.ConnSizeDone(Conn());
+
+    Analyzer::Done();
+}
 
 void ConnSize_Analyzer::ThresholdEvent(EventHandlerPtr f, uint64_t threshold, bool is_orig) {
     if ( ! f )
@@ -106,6 +113,19 @@ void ConnSize_Analyzer::DeliverPacket(int len, const u_char* data, bool is_orig,
     CheckThresholds(is_orig);
 }
 
+void ConnSize_Analyzer::AddSkipped(bool is_orig, uint64_t pkts, uint64_t bytes) {
+    if ( is_orig ) {
+        orig_bytes += bytes;
+        orig_pkts += pkts;
+    }
+    else {
+        resp_bytes += bytes;
+        resp_pkts += pkts;
+    }
+
+    CheckThresholds(is_orig);
+}
+
 void ConnSize_Analyzer::SetByteAndPacketThreshold(uint64_t threshold, bool bytes, bool orig) {
     if ( bytes ) {
         if ( orig )
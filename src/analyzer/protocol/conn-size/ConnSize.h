@@ -20,6 +20,20 @@ public:
     void SetByteAndPacketThreshold(uint64_t threshold, bool bytes, bool orig);
     uint64_t GetByteAndPacketThreshold(bool bytes, bool orig);
 
+    /**
+     * Accounts for packets that reached the connection without being
+     * delivered to the analyzer tree, e.g. because the connection is
+     * shunted. Counts feed into the record and the thresholds just like
+     * delivered packets.
+     *
+     * @param is_orig True if the packets were sent by the originator.
+     *
+     * @param pkts The number of packets to add.
+     *
+     * @param bytes The number of IP-level bytes to add.
+     */
+    void AddSkipped(bool is_orig, uint64_t pkts, uint64_t bytes);
+
     void SetDurationThreshold(double duration);
     double GetDurationThreshold() { return duration_thresh; };
 
@@ -6,8 +6,11 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <algorithm>
+#include <array>
 #include <cctype>
 #include <cinttypes>
+#include <string_view>
 
 #include "zeek/Base64.h"
 #include "zeek/Event.h"
@@ -43,6 +46,21 @@ zeek::StringValPtr extract_char_string(zeek::analyzer::Analyzer* analyzer, const
 
     return rval;
 }
+
+// Recently seen names, so that popular names share one StringVal instead of
+// getting a new one for each occurrence. Slots are picked by a hash of the
+// name and simply get replaced on collision.
+zeek::StringValPtr intern_name(const u_char* name, int len) {
+    static std::array<zeek::StringValPtr, 4096> slots;
+
+    std::string_view sv(reinterpret_cast<const char*>(name), len);
+    auto& slot = slots[std::hash<std::string_view>{}(sv) % slots.size()];
+
+    if ( ! slot || slot->ToStdStringView() != sv )
+        slot = zeek::make_intrusive<zeek::StringVal>(new zeek::String(name, len, true));
+
+    return slot;
+}
 } // namespace
 
 namespace zeek::analyzer::dns {
@@ -108,6 +126,9 @@ void DNS_Interpreter::ParseMessage(const u_char* data, int len, int is_query) {
 
     const u_char* msg_start = data; // needed for interpreting compression
 
+    compressed_names.clear();
+    compressed_names_buf.clear();
+
     data += hdr_len;
     len -= hdr_len;
 
@@ -137,7 +158,10 @@ void DNS_Interpreter::ParseMessage(const u_char* data, int len, int is_query) {
             return;
         }
 
-        StringValPtr zname = msg.query_name;
+        StringValPtr zname;
+        if ( dns_dynamic_update )
+            zname = msg.QueryName();
+
         msg.zclass = msg.aclass;
 
         if ( ! ParseAnswers(&msg, msg.an_pr_count, detail::DNS_PREREQUISITES, data, len, msg_start) ) {
@@ -260,14 +284,14 @@ bool DNS_Interpreter::ParseQuestion(detail::DNS_MsgInfo* msg, const u_char*& dat
         dns_event = dns_query_reply;
 
     if ( dns_event && ! msg->skip_event ) {
-        String* original_name = new String(name, name_end - name, true);
+        auto original_name = intern_name(name, name_end - name);
 
         // Downcase the Name to normalize it
         for ( u_char* np = name; np < name_end; ++np )
             if ( isupper(*np) )
                 *np = tolower(*np);
 
-        String* question_name = new String(name, name_end - name, true);
+        auto question_name = intern_name(name, name_end - name);
 
         SendReplyOrRejectEvent(msg, dns_event, data, len, question_name, original_name);
     }
@@ -298,7 +322,7 @@ bool DNS_Interpreter::ParseAnswerHeader(detail::DNS_MsgInfo* msg, const u_char*&
     // Note that the exact meaning of some of these fields will be
     // re-interpreted by other, more adventurous RR types.
 
-    msg->query_name = make_intrusive<StringVal>(new String(name, name_end - name, true));
+    msg->SetQueryName(name, name_end - name);
     msg->atype = static_cast<detail::RR_Type>(ExtractShort(data, len));
     msg->aclass = ExtractShort(data, len);
 
@@ -470,9 +494,12 @@ u_char* DNS_Interpreter::ExtractName(const u_char*& data, int& len, u_char* name
                                      bool downcase, int compression_depth) {
     if ( compression_depth > zeek::detail::dns_max_compression_chain_depth ) {
         analyzer->LimitReachedWeird("DNS_max_compression_chain_depth_exceeded", compression_depth);
+        deepest_compression = std::max(deepest_compression, compression_depth);
         return name;
     }
 
+    deepest_compression = std::max(deepest_compression, compression_depth);
+
     u_char* name_start = name;
 
     while ( true ) {
@@ -550,9 +577,34 @@ DNS_Interpreter::LabelParseState DNS_Interpreter::ExtractLabel(const u_char*& da
             return LabelParseState::ParseError;
         }
 
+        int end = orig_data - msg_start;
+
+        // Pointers to names already resolved for this message just get
+        // their result copied, as long as that comes out the same as
+        // following them again: the chain must stay within the depth
+        // limit, and the name must have been resolved with no more room
+        // than this pointer leaves it.
+        for ( const auto& c : compressed_names ) {
+            if ( c.offset != offset || c.end > end || c.len >= name_len ||
+                 compression_depth + 1 + c.depth > zeek::detail::dns_max_compression_chain_depth )
+                continue;
+
+            deepest_compression = std::max(deepest_compression, compression_depth + 1 + c.depth);
+
+            memcpy(name, compressed_names_buf.data() + c.start, c.len);
+            name[c.len] = 0;
+            name_len -= c.len;
+            name += c.len;
+
+            return LabelParseState::EndOfName;
+        }
+
         // Recursively resolve name.
         const u_char* recurse_data = msg_start + offset;
-        int recurse_max_len = orig_data - recurse_data;
+        int recurse_max_len = end - offset;
+
+        int prev_deepest_compression = deepest_compression;
+        deepest_compression = 0;
 
         u_char* name_end =
             ExtractName(recurse_data, recurse_max_len, name, name_len, msg_start, true, compression_depth + 1);
@@ -560,6 +612,18 @@ DNS_Interpreter::LabelParseState DNS_Interpreter::ExtractLabel(const u_char*& da
         if ( ! name_end )
             return LabelParseState::ParseError;
 
+        // Names that led to weirds don't get remembered, so that they
+        // still get reported the next time.
+        if ( deepest_compression <= zeek::detail::dns_max_compression_chain_depth && name_end - name < 255 &&
+             compressed_names.size() < MAX_COMPRESSED_NAMES ) {
+            compressed_names.push_back({static_cast<uint16_t>(offset),
+                                        static_cast<uint16_t>(deepest_compression - (compression_depth + 1)),
+                                        static_cast<uint16_t>(end), static_cast<uint16_t>(name_end - name),
+                                        static_cast<uint32_t>(compressed_names_buf.size())});
+            compressed_names_buf.append(reinterpret_cast<const char*>(name), name_end - name);
+        }
+        deepest_compression = std::max(prev_deepest_compression, deepest_compression);
+
         name_len -= name_end - name;
         name = name_end;
 
@@ -1953,14 +2017,14 @@ bool DNS_Interpreter::ParseRR_SVCB(detail::DNS_MsgInfo* msg, const u_char*& data
 }
 
 void DNS_Interpreter::SendReplyOrRejectEvent(detail::DNS_MsgInfo* msg, EventHandlerPtr event, const u_char*& data,
-                                             int& len, String* question_name, String* original_name) {
+                                             int& len, StringValPtr question_name, StringValPtr original_name) {
     auto qtype = static_cast<detail::RR_Type>(ExtractShort(data, len));
     auto qclass = ExtractShort(data, len);
 
     assert(event);
 
-    analyzer->EnqueueConnEvent(event, analyzer->ConnVal(), msg->BuildHdrVal(), make_intrusive<StringVal>(question_name),
-                               val_mgr->Count(qtype), val_mgr->Count(qclass), make_intrusive<StringVal>(original_name));
+    analyzer->EnqueueConnEvent(event, analyzer->ConnVal(), msg->BuildHdrVal(), std::move(question_name),
+                               val_mgr->Count(qtype), val_mgr->Count(qclass), std::move(original_name));
 }
 
 DNS_MsgInfo::DNS_MsgInfo(DNS_RawMsgHdr* hdr, bool arg_is_query, bool arg_is_netbios)
@@ -1988,6 +2052,18 @@ DNS_MsgInfo::DNS_MsgInfo(DNS_RawMsgHdr* hdr, bool arg_is_query, bool arg_is_netb
     is_dynamic_update = (opcode == DNS_OP_DYNAMIC_UPDATE && ! is_netbios);
 }
 
+void DNS_MsgInfo::SetQueryName(const u_char* name, int len) {
+    query_name_bytes.assign(reinterpret_cast<const char*>(name), len);
+    query_name = nullptr;
+}
+
+const StringValPtr& DNS_MsgInfo::QueryName() {
+    if ( ! query_name )
+        query_name = intern_name(reinterpret_cast<const u_char*>(query_name_bytes.data()), query_name_bytes.size());
+
+    return query_name;
+}
+
 RecordValPtr DNS_MsgInfo::BuildHdrVal() {
     static auto dns_msg = id::find_type<RecordType>("dns_msg");
     auto r = make_intrusive<RecordVal>(dns_msg);
@@ -2017,7 +2093,7 @@ RecordValPtr DNS_MsgInfo::BuildAnswerVal() {
     auto r = make_intrusive<RecordVal>(dns_answer);
 
     r->Assign(0, answer_type);
-    r->Assign(1, query_name);
+    r->Assign(1, QueryName());
     r->Assign(2, atype);
     r->Assign(3, aclass);
     r->AssignInterval(4, static_cast<double>(ttl));
@@ -2031,7 +2107,7 @@ RecordValPtr DNS_MsgInfo::BuildEDNS_Val() {
     static auto dns_edns_additional = id::find_type<RecordType>("dns_edns_additional");
     auto r = make_intrusive<RecordVal>(dns_edns_additional);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
 
     // type = 0x29 or 41 = EDNS
@@ -2098,7 +2174,7 @@ RecordValPtr DNS_MsgInfo::BuildTKEY_Val(struct TKEY_DATA* tkey) {
     static auto dns_tkey = id::find_type<RecordType>("dns_tkey");
     auto r = make_intrusive<RecordVal>(dns_tkey);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, tkey->alg_name);
     r->AssignTime(3, static_cast<double>(tkey->inception));
@@ -2117,7 +2193,7 @@ RecordValPtr DNS_MsgInfo::BuildTSIG_Val(struct TSIG_DATA* tsig) {
     double rtime = tsig->time_s + tsig->time_ms / 1000.0;
 
     // r->Assign(0, answer_type);
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, tsig->alg_name);
     r->Assign(3, tsig->sig);
@@ -2134,7 +2210,7 @@ RecordValPtr DNS_MsgInfo::BuildRRSIG_Val(RRSIG_DATA* rrsig) {
     static auto dns_rrsig_rr = id::find_type<RecordType>("dns_rrsig_rr");
     auto r = make_intrusive<RecordVal>(dns_rrsig_rr);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, rrsig->type_covered);
     r->Assign(3, rrsig->algorithm);
@@ -2154,7 +2230,7 @@ RecordValPtr DNS_MsgInfo::BuildDNSKEY_Val(DNSKEY_DATA* dnskey) {
     static auto dns_dnskey_rr = id::find_type<RecordType>("dns_dnskey_rr");
     auto r = make_intrusive<RecordVal>(dns_dnskey_rr);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, dnskey->dflags);
     r->Assign(3, dnskey->dprotocol);
@@ -2169,7 +2245,7 @@ RecordValPtr DNS_MsgInfo::BuildNSEC3_Val(NSEC3_DATA* nsec3) {
     static auto dns_nsec3_rr = id::find_type<RecordType>("dns_nsec3_rr");
     auto r = make_intrusive<RecordVal>(dns_nsec3_rr);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, nsec3->nsec_flags);
     r->Assign(3, nsec3->nsec_hash_algo);
@@ -2188,7 +2264,7 @@ RecordValPtr DNS_MsgInfo::BuildNSEC3PARAM_Val(NSEC3PARAM_DATA* nsec3param) {
     static auto dns_nsec3param_rr = id::find_type<RecordType>("dns_nsec3param_rr");
     auto r = make_intrusive<RecordVal>(dns_nsec3param_rr);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, nsec3param->nsec_flags);
     r->Assign(3, nsec3param->nsec_hash_algo);
@@ -2204,7 +2280,7 @@ RecordValPtr DNS_MsgInfo::BuildDS_Val(DS_DATA* ds) {
     static auto dns_ds_rr = id::find_type<RecordType>("dns_ds_rr");
     auto r = make_intrusive<RecordVal>(dns_ds_rr);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, ds->key_tag);
     r->Assign(3, ds->algorithm);
@@ -2219,7 +2295,7 @@ RecordValPtr DNS_MsgInfo::BuildBINDS_Val(BINDS_DATA* binds) {
     static auto dns_binds_rr = id::find_type<RecordType>("dns_binds_rr");
     auto r = make_intrusive<RecordVal>(dns_binds_rr);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, binds->algorithm);
     r->Assign(3, binds->key_id);
@@ -2234,7 +2310,7 @@ RecordValPtr DNS_MsgInfo::BuildLOC_Val(LOC_DATA* loc) {
     static auto dns_loc_rr = id::find_type<RecordType>("dns_loc_rr");
     auto r = make_intrusive<RecordVal>(dns_loc_rr);
 
-    r->Assign(0, query_name);
+    r->Assign(0, QueryName());
     r->Assign(1, answer_type);
     r->Assign(2, loc->version);
     r->Assign(3, loc->size);
@@ -2,6 +2,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include "zeek/analyzer/protocol/tcp/TCP.h"
 
 namespace zeek::analyzer::dns {
@@ -298,6 +301,17 @@ class DNS_MsgInfo final {
 public:
     DNS_MsgInfo(DNS_RawMsgHdr* hdr, bool is_query, bool is_netbios);
 
+    /**
+     * Sets the name of the current RR. The corresponding value only gets
+     * built once QueryName() asks for it.
+     */
+    void SetQueryName(const u_char* name, int len);
+
+    /**
+     * Returns the name of the current RR as set by SetQueryName().
+     */
+    const StringValPtr& QueryName();
+
     RecordValPtr BuildHdrVal();
     RecordValPtr BuildAnswerVal();
     RecordValPtr BuildEDNS_Val();
@@ -335,13 +349,16 @@ public:
     bool is_dynamic_update = false; ///< whether this message is a dynamic update
     bool is_netbios = false;        ///< whether this request is from netbios
 
-    StringValPtr query_name;
     RR_Type atype = TYPE_ALL;
     uint16_t aclass = 0; ///< normally = 1, inet
     uint32_t ttl = 0;
     uint16_t zclass = 0; ///< class of the zone for dynamic updates
 
     DNS_AnswerType answer_type = DNS_QUESTION;
+
+private:
+    std::string query_name_bytes;
+    StringValPtr query_name; ///< built from query_name_bytes on demand
 };
 
 class DNS_Interpreter final {
@@ -414,11 +431,26 @@ private:
     bool ParseRR_SVCB(detail::DNS_MsgInfo* msg, const u_char*& data, int& len, int rdlength, const u_char* msg_start,
                       const RR_Type& svcb_type);
     void SendReplyOrRejectEvent(detail::DNS_MsgInfo* msg, EventHandlerPtr event, const u_char*& data, int& len,
-                                String* question_name, String* original_name);
+                                StringValPtr question_name, StringValPtr original_name);
+
+    // A name that a compression pointer of the current message resolved to.
+    struct CompressedName {
+        uint16_t offset; ///< offset the pointer points to
+        uint16_t depth;  ///< length of the chain of further pointers followed
+        uint16_t end;    ///< offset of the pointer, bounding how far the name could extend
+        uint16_t len;    ///< length of the name
+        uint32_t start;  ///< offset of the name in compressed_names_buf
+    };
+
+    static constexpr size_t MAX_COMPRESSED_NAMES = 64;
 
     analyzer::Analyzer* analyzer = nullptr;
     bool first_message = true;
     bool is_netbios = false;
+
+    std::vector<CompressedName> compressed_names;
+    std::string compressed_names_buf;
+    int deepest_compression = 0; ///< deepest compression_depth that ExtractName() saw
 };
 
 enum TCP_DNS_state : uint8_t {
@@ -5,15 +5,20 @@
 #include <algorithm>
 #include <cctype>
 #include <cinttypes>
+#include <cmath>
 #include <cstdlib>
 #include <string>
 
 #include "zeek/Event.h"
 #include "zeek/NetVar.h"
+#include "zeek/RuleMatcher.h"
+#include "zeek/RunState.h"
 #include "zeek/analyzer/Manager.h"
 #include "zeek/analyzer/protocol/http/events.bif.h"
 #include "zeek/analyzer/protocol/mime/MIME.h"
+#include "zeek/file_analysis/File.h"
 #include "zeek/file_analysis/Manager.h"
+#include "zeek/packet_analysis/Manager.h"
 
 namespace zeek::analyzer::http {
 
@@ -203,20 +208,90 @@ private:
 };
 
 void HTTP_Entity::DeliverBody(int len, const char* data, bool trailing_CRLF) {
-    if ( encoding == GZIP || encoding == DEFLATE ) {
-        analyzer::zip::ZIP_Analyzer::Method method =
-            encoding == GZIP ? analyzer::zip::ZIP_Analyzer::GZIP : analyzer::zip::ZIP_Analyzer::DEFLATE;
-
-        if ( ! zip ) {
-            // We don't care about the direction here.
-            zip = new analyzer::zip::ZIP_Analyzer(http_message->MyHTTP_Analyzer()->Conn(), false, method);
-            zip->SetOutputHandler(new UncompressedOutput(this));
+    if ( ! IsCompressed() ) {
+        DeliverBodyClear(len, data, trailing_CRLF);
+        return;
+    }
+
+    if ( decompression_stopped )
+        return;
+
+    if ( ! DecompressionWanted() ) {
+        decompression_stopped = true;
+        return;
+    }
+
+    auto* a = http_message->MyHTTP_Analyzer();
+    uint64_t budget = a->DecompressionBudget();
+
+    if ( budget == 0 ) {
+        a->Weird("HTTP_decompression_budget_exhausted");
+        decompression_stopped = true;
+        return;
+    }
+
+    if ( ! zip ) {
+        analyzer::zip::ZIP_Analyzer::Method method;
+
+        switch ( encoding ) {
+            case GZIP: method = analyzer::zip::ZIP_Analyzer::GZIP; break;
+            case BROTLI: method = analyzer::zip::ZIP_Analyzer::BROTLI; break;
+            case ZSTD: method = analyzer::zip::ZIP_Analyzer::ZSTD; break;
+            default: method = analyzer::zip::ZIP_Analyzer::DEFLATE; break;
         }
 
-        zip->NextStream(len, reinterpret_cast<const u_char*>(data), false);
+        // We don't care about the direction here.
+        zip = new analyzer::zip::ZIP_Analyzer(a->Conn(), false, method);
+        zip->SetOutputHandler(new UncompressedOutput(this));
+    }
+
+    uint64_t before = zip->OutputBytes();
+    zip->SetOutputLimit(budget > UINT64_MAX - before ? UINT64_MAX : before + budget);
+    zip->NextStream(len, reinterpret_cast<const u_char*>(data), false);
+    a->ConsumeDecompressionBudget(zip->OutputBytes() - before);
+
+    if ( zip->OutputLimitReached() ) {
+        a->Weird("HTTP_decompression_budget_exhausted");
+        decompression_stopped = true;
     }
-    else
-        DeliverBodyClear(len, data, trailing_CRLF);
+}
+
+bool HTTP_Entity::DecompressionWanted() {
+    if ( file_ignored ) {
+        if ( BifConst::http_decompress_stopped_files )
+            return true;
+    }
+    else if ( BifConst::http_decompress_unanalyzed_files || ! FileUnanalyzed() )
+        return true;
+
+    // Multipart bodies contain further entities with files of their own.
+    if ( content_type == analyzer::mime::CONTENT_TYPE_MULTIPART ||
+         content_type == analyzer::mime::CONTENT_TYPE_MESSAGE )
+        return true;
+
+    if ( http_entity_data || (zeek::detail::rule_matcher && zeek::detail::rule_matcher->HasHTTPBodyRule()) )
+        return true;
+
+    // Anything attached to the HTTP analyzer sees the decompressed body.
+    return ! http_message->MyHTTP_Analyzer()->GetChildren().empty();
+}
+
+bool HTTP_Entity::FileUnanalyzed() {
+    auto* f = precomputed_file_id.empty() ? nullptr : file_mgr->LookupFile(precomputed_file_id);
+
+    if ( ! f || f->NeedsContent() ) {
+        unanalyzed_since = 0;
+        return false;
+    }
+
+    // Give script handlers of the file's events, such as file_sniff, the
+    // chance to attach analyzers before giving up on the body.
+    auto packet = packet_mgr->PacketsProcessed();
+
+    if ( unanalyzed_since == 0 )
+        unanalyzed_since = packet;
+
+    return packet > unanalyzed_since;
 }
 
 void HTTP_Entity::DeliverBodyClear(int len, const char* data, bool trailing_CRLF) {
@@ -306,7 +381,11 @@ void HTTP_Entity::SubmitData(int len, const char* buf) {
     if ( deliver_body )
         analyzer::mime::MIME_Entity::SubmitData(len, buf);
 
-    if ( send_size && (encoding == GZIP || encoding == DEFLATE) )
+    // The file manager drops the ID once it's no longer interested in the
+    // file's data.
+    bool had_file = ! precomputed_file_id.empty();
+
+    if ( send_size && IsCompressed() )
         // Auto-decompress in DeliverBody invalidates sizes derived from headers
         send_size = false;
 
@@ -335,6 +414,9 @@ void HTTP_Entity::SubmitData(int len, const char* buf) {
                              http_message->IsOrig(), precomputed_file_id);
     }
 
+    if ( had_file && precomputed_file_id.empty() )
+        file_ignored = true;
+
     send_size = false;
 }
 
@@ -554,6 +636,13 @@ void HTTP_Entity::SubmitHeader(analyzer::mime::MIME_Header* h) {
             encoding = GZIP;
         if ( analyzer::mime::istrequal(vt, "deflate") )
             encoding = DEFLATE;
+        // Without library support, these bodies pass through as they are.
+        if ( analyzer::mime::istrequal(vt, "br") &&
+             analyzer::zip::ZIP_Analyzer::MethodSupported(analyzer::zip::ZIP_Analyzer::BROTLI) )
+            encoding = BROTLI;
+        if ( analyzer::mime::istrequal(vt, "zstd") &&
+             analyzer::zip::ZIP_Analyzer::MethodSupported(analyzer::zip::ZIP_Analyzer::ZSTD) )
+            encoding = ZSTD;
     }
     else if ( analyzer::mime::istrequal(h->get_name(), "expect") ) {
         data_chunk_t vt = h->get_value_token();
@@ -657,7 +746,7 @@ void HTTP_Entity::SubmitAllHeaders() {
     // Turn plain delivery on permanently for compressed bodies without
     // content-length headers or if connection is to be closed afterwards
     // anyway.
-    else if ( http_message->MyHTTP_Analyzer()->IsConnectionClose() || encoding == GZIP || encoding == DEFLATE ) {
+    else if ( http_message->MyHTTP_Analyzer()->IsConnectionClose() || IsCompressed() ) {
         // FIXME: Using INT_MAX is kind of a hack here.  Better
         // would be to make -1 as special value interpreted as
         // "until the end of the connection".
@@ -924,6 +1013,49 @@ void HTTP_Analyzer::Done() {
     */
 }
 
+namespace {
+
+// Bytes decompressed across all HTTP analyzers during the current second of
+// network time.
+struct {
+    double second = 0.0;
+    uint64_t used = 0;
+} global_decompression;
+
+} // namespace
+
+uint64_t HTTP_Analyzer::DecompressionBudget() const {
+    uint64_t budget = UINT64_MAX;
+
+    if ( BifConst::http_max_decompressed_bytes_per_conn > 0 ) {
+        if ( decompressed_bytes >= BifConst::http_max_decompressed_bytes_per_conn )
+            return 0;
+
+        budget = BifConst::http_max_decompressed_bytes_per_conn - decompressed_bytes;
+    }
+
+    if ( BifConst::http_decompression_bytes_per_second > 0 ) {
+        double second = std::floor(run_state::network_time);
+
+        if ( second != global_decompression.second ) {
+            global_decompression.second = second;
+            global_decompression.used = 0;
+        }
+
+        if ( global_decompression.used >= BifConst::http_decompression_bytes_per_second )
+            return 0;
+
+        budget = std::min(budget, BifConst::http_decompression_bytes_per_second - global_decompression.used);
+    }
+
+    return budget;
+}
+
+void HTTP_Analyzer::ConsumeDecompressionBudget(uint64_t bytes) {
+    decompressed_bytes += bytes;
+    global_decompression.used += bytes;
+}
+
 void HTTP_Analyzer::DeliverStream(int len, const u_char* data, bool is_orig) {
     analyzer::tcp::TCP_ApplicationAnalyzer::DeliverStream(len, data, is_orig);
 
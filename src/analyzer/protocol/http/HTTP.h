@@ -59,9 +59,12 @@ protected:
     int expect_body;
     int64_t body_length;
     int64_t header_length;
-    enum : uint8_t { IDENTITY, GZIP, COMPRESS, DEFLATE } encoding;
+    enum : uint8_t { IDENTITY, GZIP, COMPRESS, DEFLATE, BROTLI, ZSTD } encoding;
     analyzer::zip::ZIP_Analyzer* zip;
     bool deliver_body;
+    bool decompression_stopped = false; // set once we gave up decompressing the body
+    bool file_ignored = false;          // set once file analysis lost interest in the body
+    uint64_t unanalyzed_since = 0;      // packet since which the body's file has no analyzers
     bool is_partial_content;
     uint64_t offset;
     int64_t instance_length; // total length indicated by content-range
@@ -74,6 +77,17 @@ protected:
     void DeliverBody(int len, const char* data, bool trailing_CRLF);
     void DeliverBodyClear(int len, const char* data, bool trailing_CRLF);
 
+    bool IsCompressed() const {
+        return encoding == GZIP || encoding == DEFLATE || encoding == BROTLI || encoding == ZSTD;
+    }
+
+    // Returns false if nothing would look at the body once decompressed.
+    bool DecompressionWanted();
+
+    // Returns true if the body's file has gone without analyzers since an
+    // earlier packet.
+    bool FileUnanalyzed();
+
     void SubmitData(int len, const char* buf) override;
 
     void SetPlainDelivery(int64_t length);
@@ -196,6 +210,18 @@ public:
     int GetRequestOngoing() { return request_ongoing; };
     int GetReplyOngoing() { return reply_ongoing; };
 
+    /**
+     * Returns the number of bytes the analyzer may currently still
+     * decompress, given both the per-connection limit and the global
+     * per-second budget for HTTP body decompression.
+     */
+    uint64_t DecompressionBudget() const;
+
+    /**
+     * Accounts for decompressed bytes against the decompression budgets.
+     */
+    void ConsumeDecompressionBudget(uint64_t bytes);
+
     static analyzer::Analyzer* Instantiate(Connection* conn) { return new HTTP_Analyzer(conn); }
 
     static bool Available() {
@@ -275,6 +301,8 @@ protected:
 
     HTTP_Message* request_message;
     HTTP_Message* reply_message;
+
+    uint64_t decompressed_bytes = 0;
 };
 
 extern bool is_reserved_URI_char(unsigned char ch);
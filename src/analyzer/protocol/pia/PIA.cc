@@ -65,16 +65,30 @@ void PIA::AddToBuffer(Buffer* buffer, int len, const u_char* data, bool is_orig,
 }
 
 void PIA::ReplayPacketBuffer(analyzer::Analyzer* analyzer) {
-    DBG_LOG(DBG_ANALYZER, "PIA replaying %" PRIu64 " total packet bytes", pkt_buffer.size);
+    DBG_LOG(DBG_ANALYZER, "PIA replaying %" PRId64 " total packet bytes", pkt_buffer.size);
 
     for ( DataBlock* b = pkt_buffer.head; b; b = b->next )
         analyzer->DeliverPacket(b->len, b->data, b->is_orig, -1, b->ip, 0);
 }
 
+void PIA::ReleaseBuffers() {
+    stop_buffering = false;
+
+    if ( pkt_buffer.state != INIT && pkt_buffer.state != BUFFERING )
+        return;
+
+    DBG_LOG(DBG_ANALYZER, "PIA releasing %" PRId64 " packet bytes after confirmation", pkt_buffer.size);
+    ClearBuffer(&pkt_buffer);
+    pkt_buffer.state = zeek::detail::dpd_match_only_beginning ? SKIPPING : MATCHING_ONLY;
+}
+
 void PIA::PIA_Done() { FinishEndpointMatcher(); }
 
 void PIA::PIA_DeliverPacket(int len, const u_char* data, bool is_orig, uint64_t seq, const IP_Hdr* ip, int caplen,
                             bool clear_state) {
+    if ( stop_buffering )
+        ReleaseBuffers();
+
     if ( pkt_buffer.state == SKIPPING )
         return;
 
@@ -286,6 +300,9 @@ void PIA::FirstPacket(bool is_orig, const std::optional<TransportProto>& proto,
 void PIA_TCP::DeliverStream(int len, const u_char* data, bool is_orig) {
     analyzer::tcp::TCP_ApplicationAnalyzer::DeliverStream(len, data, is_orig);
 
+    if ( stop_buffering )
+        ReleaseBuffers();
+
     if ( stream_buffer.state == SKIPPING )
         return;
 
@@ -313,6 +330,9 @@ void PIA_TCP::DeliverStream(int len, const u_char* data, bool is_orig) {
 void PIA_TCP::Undelivered(uint64_t seq, int len, bool is_orig) {
     analyzer::tcp::TCP_ApplicationAnalyzer::Undelivered(seq, len, is_orig);
 
+    if ( stop_buffering )
+        ReleaseBuffers();
+
     if ( stream_buffer.state != BUFFERING )
         return;
 
@@ -436,10 +456,21 @@ void PIA_TCP::ActivateAnalyzer(zeek::Tag tag, const zeek::detail::Rule* rule) {
     tcp->SetReassembler(reass_orig, reass_resp);
 }
 
+void PIA_TCP::ReleaseBuffers() {
+    PIA::ReleaseBuffers();
+
+    if ( stream_buffer.state != INIT && stream_buffer.state != BUFFERING )
+        return;
+
+    DBG_LOG(DBG_ANALYZER, "PIA_TCP releasing %" PRId64 " stream bytes after confirmation", stream_buffer.size);
+    ClearBuffer(&stream_buffer);
+    stream_buffer.state = zeek::detail::dpd_match_only_beginning ? SKIPPING : MATCHING_ONLY;
+}
+
 void PIA_TCP::DeactivateAnalyzer(zeek::Tag tag) { reporter->InternalError("PIA_TCP::Deact not implemented yet"); }
 
 void PIA_TCP::ReplayStreamBuffer(analyzer::Analyzer* analyzer) {
-    DBG_LOG(DBG_ANALYZER, "PIA_TCP replaying %" PRIu64 " total stream bytes", stream_buffer.size);
+    DBG_LOG(DBG_ANALYZER, "PIA_TCP replaying %" PRId64 " total stream bytes", stream_buffer.size);
 
     for ( DataBlock* b = stream_buffer.head; b; b = b->next ) {
         if ( b->data )
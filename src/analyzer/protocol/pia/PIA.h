@@ -38,6 +38,12 @@ public:
 
     void ReplayPacketBuffer(analyzer::Analyzer* analyzer);
 
+    // Called when an analyzer has confirmed the connection's protocol.
+    // With the next input, the PIA frees its buffers and stops buffering,
+    // as if they had filled up. (Not right away, as we may be in the middle
+    // of replaying them.)
+    void StopBuffering() { stop_buffering = true; }
+
     // The first packet for each direction of a connection is passed
     // in here. This initializes the signature engine state for DPD.
     //
@@ -107,6 +113,9 @@ protected:
 
     DataBlock* CurrentPacket() { return &current_packet; }
 
+    // Does the work for StopBuffering().
+    virtual void ReleaseBuffers();
+
     void DoMatch(const u_char* data, int len, bool is_orig, bool bol, bool eol, bool clear_state,
                  const IP_Hdr* ip = nullptr);
 
@@ -114,6 +123,7 @@ protected:
     void SetConn(Connection* c) { conn = c; }
 
     Buffer pkt_buffer;
+    bool stop_buffering = false;
 
 private:
     // Joint backend for the two public FirstPacket() methods.
@@ -184,6 +194,8 @@ protected:
     void ActivateAnalyzer(zeek::Tag tag, const zeek::detail::Rule* rule = nullptr) override;
     void DeactivateAnalyzer(zeek::Tag tag) override;
 
+    void ReleaseBuffers() override;
+
 private:
     // FIXME: Not sure yet whether we need both pkt_buffer and stream_buffer.
     // In any case, it's easier this way...
@@ -24,7 +24,11 @@ refactors as C++ development is not our main profession.
 #include <array>
 #include <cstdint>
 #include <cstdlib>
+#include <list>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 // OpenSSL imports
@@ -35,6 +39,10 @@ refactors as C++ development is not our main profession.
 // Import HILTI
 #include <hilti/rt/libhilti.h>
 
+#include "zeek/telemetry/Manager.h"
+
+#include "zeek/3rdparty/doctest.h"
+
 namespace {
 
 // Struct to store decryption info for this specific connection
@@ -60,6 +68,13 @@ const size_t AEAD_HP_LEN = 16;
 const size_t AEAD_SAMPLE_LENGTH = 16;
 const size_t AEAD_TAG_LENGTH = 16;
 const size_t MAXIMUM_PACKET_NUMBER_LENGTH = 4;
+const size_t MAXIMUM_KEY_CACHE_ENTRIES = 4096;
+
+zeek::telemetry::CounterPtr key_cache_hits;
+zeek::telemetry::CounterPtr key_cache_misses;
+zeek::telemetry::CounterPtr packets_decrypted;
+zeek::telemetry::CounterPtr decryption_failures;
+zeek::telemetry::GaugePtr key_cache_entries;
 
 EVP_CIPHER_CTX* get_aes_128_ecb() {
     static EVP_CIPHER_CTX* ctx = nullptr;
@@ -90,9 +105,16 @@ DecryptionInformation remove_header_protection(const std::vector<uint8_t>& clien
     DecryptionInformation decryptInfo;
     int outlen;
     auto* ctx = get_aes_128_ecb();
-    EVP_CIPHER_CTX_set_key_length(ctx, client_hp.size());
-    // Passing an 1 means ENCRYPT
-    EVP_CipherInit_ex(ctx, NULL, NULL, client_hp.data(), NULL, 1);
+
+    // Coalesced packets and retransmissions use the same key, so only
+    // expand it when it changes.
+    static std::vector<uint8_t> current_hp;
+    if ( client_hp != current_hp ) {
+        EVP_CIPHER_CTX_set_key_length(ctx, client_hp.size());
+        // Passing an 1 means ENCRYPT
+        EVP_CipherInit_ex(ctx, NULL, NULL, client_hp.data(), NULL, 1);
+        current_hp = client_hp;
+    }
 
     static_assert(AEAD_SAMPLE_LENGTH > 0);
     assert(data.size() >= encrypted_offset + MAXIMUM_PACKET_NUMBER_LENGTH + AEAD_SAMPLE_LENGTH);
@@ -186,10 +208,16 @@ hilti::rt::Bytes decrypt(const std::vector<uint8_t>& client_key, const hilti::rt
     // Set the sizes for the IV and KEY
     EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_IVLEN, decryptInfo.nonce.size(), NULL);
 
-    EVP_CIPHER_CTX_set_key_length(ctx, client_key.size());
-
-    // Set the KEY and IV
-    EVP_CipherInit_ex(ctx, NULL, NULL, client_key.data(), decryptInfo.nonce.data(), 0);
+    // Set the KEY and IV. As for header protection, the key only gets
+    // expanded when it differs from the one used last.
+    static std::vector<uint8_t> current_key;
+    if ( client_key != current_key ) {
+        EVP_CIPHER_CTX_set_key_length(ctx, client_key.size());
+        EVP_CipherInit_ex(ctx, NULL, NULL, client_key.data(), decryptInfo.nonce.data(), 0);
+        current_key = client_key;
+    }
+    else
+        EVP_CipherInit_ex(ctx, NULL, NULL, NULL, decryptInfo.nonce.data(), 0);
 
     // Set the tag to be validated after decryption
     EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_CCM_SET_TAG, tag_to_check_length, const_cast<void*>(tag_to_check));
@@ -202,8 +230,12 @@ hilti::rt::Bytes decrypt(const std::vector<uint8_t>& client_key, const hilti::rt
     EVP_CipherUpdate(ctx, decrypt_buffer.data(), &out, encrypted_payload, encrypted_payload_size);
 
     // Validate whether the decryption was successful or not
-    if ( EVP_CipherFinal_ex(ctx, NULL, &out2) == 0 )
+    if ( EVP_CipherFinal_ex(ctx, NULL, &out2) == 0 ) {
+        decryption_failures->Inc();
         throw hilti::rt::RuntimeError("decryption failed");
+    }
+
+    packets_decrypted->Inc();
 
     // Copy the decrypted data from the decrypted buffer into a Bytes instance.
     return hilti::rt::Bytes(decrypt_buffer.data(), decrypt_buffer.data() + out);
@@ -437,6 +469,82 @@ public:
 HkdfCtx QuicPacketProtectionV2::hkdf_ctxs = {0};
 std::unique_ptr<QuicPacketProtectionV2> QuicPacketProtectionV2::instance = nullptr;
 
+/*
+Key material for decrypting the INITIAL packets of one direction.
+*/
+struct InitialKeys {
+    std::vector<uint8_t> key;
+    std::vector<uint8_t> iv;
+    std::vector<uint8_t> hp;
+};
+
+/*
+The keys of INITIAL packets only depend on the version, the direction and the
+client's initial destination connection ID, so retransmissions and coalesced
+packets can reuse them instead of running HKDF again. Least recently used
+entries get evicted once there are more than MAXIMUM_KEY_CACHE_ENTRIES, which
+bounds the memory used for connection IDs that won't be seen again.
+*/
+class InitialKeyCache {
+public:
+    explicit InitialKeyCache(size_t arg_max_entries = MAXIMUM_KEY_CACHE_ENTRIES) : max_entries(arg_max_entries) {}
+
+    const InitialKeys* Lookup(const std::string& id) {
+        auto it = index.find(id);
+        if ( it == index.end() )
+            return nullptr;
+
+        lru.splice(lru.begin(), lru, it->second);
+        return &it->second->second;
+    }
+
+    const InitialKeys* Insert(std::string id, InitialKeys keys) {
+        lru.emplace_front(std::move(id), std::move(keys));
+        index.emplace(lru.front().first, lru.begin());
+
+        if ( index.size() > max_entries ) {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+
+        return &lru.front().second;
+    }
+
+    size_t Size() const { return index.size(); }
+
+    // Builds the lookup key for a set of keys.
+    static std::string Id(uint32_t version, bool from_client, const hilti::rt::Bytes& connection_id) {
+        std::string id(reinterpret_cast<const char*>(&version), sizeof(version));
+        id.push_back(from_client ? 1 : 0);
+        id.append(connection_id.str());
+        return id;
+    }
+
+private:
+    using List = std::list<std::pair<std::string, InitialKeys>>;
+
+    List lru; // Most recently used first.
+    std::unordered_map<std::string_view, List::iterator> index;
+    size_t max_entries;
+};
+
+InitialKeyCache key_cache;
+
+void initialize_telemetry() {
+    key_cache_hits = zeek::telemetry_mgr->CounterInstance("zeek", "quic_initial_key_cache_hits", {},
+                                                          "Number of QUIC INITIAL packets that reused cached keys");
+    key_cache_misses = zeek::telemetry_mgr->CounterInstance("zeek", "quic_initial_key_cache_misses", {},
+                                                            "Number of QUIC INITIAL key derivations");
+    packets_decrypted = zeek::telemetry_mgr->CounterInstance("zeek", "quic_initial_packets_decrypted", {},
+                                                             "Number of QUIC INITIAL packets decrypted");
+    decryption_failures = zeek::telemetry_mgr->CounterInstance("zeek", "quic_initial_decryption_failures", {},
+                                                               "Number of QUIC INITIAL packets failing decryption");
+    key_cache_entries =
+        zeek::telemetry_mgr->GaugeInstance("zeek", "quic_initial_key_cache_entries", {},
+                                           "Number of QUIC INITIAL keys cached", "",
+                                           []() { return static_cast<double>(key_cache.Size()); });
+}
+
 } // namespace
 
 /*
@@ -452,6 +560,7 @@ hilti::rt::Bytes QUIC_decrypt_crypto_payload(const hilti::rt::integer::safe<uint
     if ( ! initialized ) {
         QuicPacketProtectionV1::Initialize();
         QuicPacketProtectionV2::Initialize();
+        initialize_telemetry();
         initialized = true;
     }
 
@@ -475,15 +584,66 @@ hilti::rt::Bytes QUIC_decrypt_crypto_payload(const hilti::rt::integer::safe<uint
         throw hilti::rt::RuntimeError(hilti::rt::fmt("unable to decrypt QUIC version 0x%lx", version));
     }
 
-    const auto& secret = qpp->GetSecret(from_client, v, connection_id);
-    std::vector<uint8_t> key = qpp->GetKey(secret);
-    std::vector<uint8_t> iv = qpp->GetIv(secret);
-    std::vector<uint8_t> hp = qpp->GetHp(secret);
+    auto id = InitialKeyCache::Id(v, from_client, connection_id);
+    const InitialKeys* keys = key_cache.Lookup(id);
 
-    DecryptionInformation decryptInfo = remove_header_protection(hp, encrypted_offset, data);
+    if ( keys )
+        key_cache_hits->Inc();
+    else {
+        key_cache_misses->Inc();
+
+        const auto& secret = qpp->GetSecret(from_client, v, connection_id);
+        keys = key_cache.Insert(std::move(id), {qpp->GetKey(secret), qpp->GetIv(secret), qpp->GetHp(secret)});
+    }
+
+    DecryptionInformation decryptInfo = remove_header_protection(keys->hp, encrypted_offset, data);
 
     // Calculate the correct nonce for the decryption
-    decryptInfo.nonce = calculate_nonce(std::move(iv), decryptInfo.packet_number);
+    decryptInfo.nonce = calculate_nonce(keys->iv, decryptInfo.packet_number);
 
-    return decrypt(key, data, payload_length, decryptInfo);
+    return decrypt(keys->key, data, payload_length, decryptInfo);
 }
+
+TEST_SUITE_BEGIN("QUIC InitialKeyCache");
+
+TEST_CASE("ids") {
+    hilti::rt::Bytes cid("\x83\x94\xc8\xf0\x3e\x51\x57\x08");
+    hilti::rt::Bytes other_cid("\x83\x94\xc8\xf0\x3e\x51\x57\x09");
+
+    auto id = InitialKeyCache::Id(1, true, cid);
+    CHECK(id == InitialKeyCache::Id(1, true, cid));
+    CHECK(id != InitialKeyCache::Id(1, false, cid));
+    CHECK(id != InitialKeyCache::Id(0x6b3343cf, true, cid));
+    CHECK(id != InitialKeyCache::Id(1, true, other_cid));
+}
+
+TEST_CASE("lookup and eviction") {
+    InitialKeyCache cache(2);
+    auto keys = [](uint8_t n) { return InitialKeys{{n}, {n}, {n}}; };
+
+    CHECK(cache.Lookup("a") == nullptr);
+
+    cache.Insert("a", keys(1));
+    cache.Insert("b", keys(2));
+    CHECK(cache.Size() == 2);
+
+    auto a = cache.Lookup("a");
+    REQUIRE(a);
+    CHECK(a->key == std::vector<uint8_t>{1});
+
+    // "b" is least recently used now, so it's the one to go.
+    cache.Insert("c", keys(3));
+    CHECK(cache.Size() == 2);
+    CHECK(cache.Lookup("b") == nullptr);
+    REQUIRE(cache.Lookup("a"));
+    REQUIRE(cache.Lookup("c"));
+    CHECK(cache.Lookup("c")->hp == std::vector<uint8_t>{3});
+
+    // Now "a" is.
+    cache.Insert("d", keys(4));
+    CHECK(cache.Lookup("a") == nullptr);
+    CHECK(cache.Lookup("c"));
+    CHECK(cache.Lookup("d"));
+}
+
+TEST_SUITE_END();
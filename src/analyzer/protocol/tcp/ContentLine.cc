@@ -2,11 +2,72 @@
 
 #include "zeek/analyzer/protocol/tcp/ContentLine.h"
 
+#include <bit>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "zeek/Conn.h"
 #include "zeek/Reporter.h"
 #include "zeek/analyzer/protocol/tcp/TCP.h"
+#include "zeek/packet_analysis/protocol/ip/conn_key/IPBasedConnKey.h"
+
+#include "zeek/3rdparty/doctest.h"
 
 namespace zeek::analyzer::tcp {
 
+namespace {
+
+// Returns the first position in [data, end) holding one of the bytes a, b or
+// c, or end if there's none. SSE2 and NEON are part of the baseline of the
+// architectures providing them, so there's no need for runtime dispatch.
+const u_char* find_any_of(const u_char* data, const u_char* end, u_char a, u_char b, u_char c) {
+#if defined(__SSE2__)
+    const __m128i va = _mm_set1_epi8(static_cast<char>(a));
+    const __m128i vb = _mm_set1_epi8(static_cast<char>(b));
+    const __m128i vc = _mm_set1_epi8(static_cast<char>(c));
+
+    for ( ; end - data >= 16; data += 16 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)), _mm_cmpeq_epi8(v, vc));
+
+        if ( auto mask = static_cast<unsigned int>(_mm_movemask_epi8(m)) )
+            return data + std::countr_zero(mask);
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t va = vdupq_n_u8(a);
+    const uint8x16_t vb = vdupq_n_u8(b);
+    const uint8x16_t vc = vdupq_n_u8(c);
+
+    for ( ; end - data >= 16; data += 16 ) {
+        uint8x16_t v = vld1q_u8(data);
+        uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, va), vceqq_u8(v, vb)), vceqq_u8(v, vc));
+
+        // Narrow the byte mask to four bits per byte.
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+
+        if ( mask )
+            return data + std::countr_zero(mask) / 4;
+    }
+#endif
+
+    for ( ; data < end; ++data ) {
+        if ( *data == a || *data == b || *data == c )
+            return data;
+    }
+
+    return end;
+}
+
+} // namespace
+
 ContentLine_Analyzer::ContentLine_Analyzer(Connection* conn, bool orig, int max_line_length)
     : TCP_SupportAnalyzer("CONTENTLINE", conn, orig), max_line_length(max_line_length) {
     InitState();
@@ -230,6 +291,23 @@ int ContentLine_Analyzer::DoDeliverOnce(int len, const u_char* data) {
             }
         }
 
+        if ( c != '\r' && c != '\n' && (c != '\0' || ! flag_NULs) && last_char != '\r' ) {
+            // Copy everything up to the next character needing a closer
+            // look in one go, as far as the buffer allows. The rest goes
+            // through the next iteration as usual.
+            const u_char* special = find_any_of(data, data + len, '\r', '\n', flag_NULs ? '\0' : '\r');
+            int n = std::min(static_cast<int>(special - data), buf_len - offset);
+
+            memcpy(buf + offset, data, n);
+            offset += n;
+            last_char = data[n - 1];
+
+            // The loop's increment accounts for one more.
+            data += n - 1;
+            len -= n - 1;
+            continue;
+        }
+
         switch ( c ) {
             case '\r':
                 // Look ahead for '\n'.
@@ -335,3 +413,284 @@ void ContentLine_Analyzer::SkipBytes(int64_t length) {
 }
 
 } // namespace zeek::analyzer::tcp
+
+TEST_SUITE_BEGIN("contentline");
+
+TEST_CASE("find_any_of") {
+    using zeek::analyzer::tcp::find_any_of;
+
+    std::string s(100, 'x');
+    const auto* data = reinterpret_cast<const u_char*>(s.data());
+
+    CHECK(find_any_of(data, data + s.size(), '\r', '\n', '\0') == data + s.size());
+
+    for ( size_t i = 0; i < s.size(); ++i ) {
+        for ( char c : {'\r', '\n', '\0'} ) {
+            s[i] = c;
+            CHECK(find_any_of(data, data + s.size(), '\r', '\n', '\0') == data + i);
+            CHECK(find_any_of(data + i + 1, data + s.size(), '\r', '\n', '\0') == data + s.size());
+            s[i] = 'x';
+        }
+    }
+
+    s[50] = '\0';
+    s[70] = '\n';
+    CHECK(find_any_of(data, data + s.size(), '\r', '\n', '\r') == data + 70);
+    CHECK(find_any_of(data, data + 60, '\r', '\n', '\r') == data + 60);
+}
+
+namespace {
+
+using zeek::analyzer::tcp::ContentLine_Analyzer;
+
+// The byte-by-byte line splitting that DoDeliverOnce() used before it looked
+// for terminators in bulk, kept to compare the two.
+class Reference_ContentLine_Analyzer : public ContentLine_Analyzer {
+public:
+    using ContentLine_Analyzer::ContentLine_Analyzer;
+
+protected:
+    // Same as ContentLine_Analyzer::DoDeliver(), but using DoDeliverOnceByByte().
+    void DoDeliver(int len, const u_char* data) override {
+        seq_delivered_in_lines = seq;
+
+        while ( len > 0 && ! SkipDeliveries() ) {
+            if ( (CR_LF_as_EOL & zeek::analyzer::tcp::CR_as_EOL) && last_char == '\r' && *data == '\n' ) {
+                last_char = *data;
+                --len;
+                ++data;
+                ++seq;
+                ++seq_delivered_in_lines;
+            }
+
+            if ( plain_delivery_length > 0 ) {
+                auto deliver_plain = static_cast<int>(std::min<int64_t>(plain_delivery_length, len));
+
+                last_char = 0;
+                plain_delivery_length -= deliver_plain;
+                is_plain = true;
+
+                deliver_stream_remaining_length = len - deliver_plain;
+                ForwardStream(deliver_plain, data, IsOrig());
+
+                is_plain = false;
+
+                data += deliver_plain;
+                len -= deliver_plain;
+                if ( len == 0 )
+                    return;
+            }
+
+            if ( skip_pending > 0 )
+                SkipBytes(skip_pending);
+
+            if ( seq < seq_to_skip ) {
+                int64_t skip_len = seq_to_skip - seq;
+                if ( skip_len > len )
+                    skip_len = len;
+
+                ForwardUndelivered(seq, skip_len, IsOrig());
+
+                len -= skip_len;
+                data += skip_len;
+                seq += skip_len;
+                seq_delivered_in_lines += skip_len;
+            }
+
+            if ( len <= 0 )
+                break;
+
+            int n = DoDeliverOnceByByte(len, data);
+            len -= n;
+            data += n;
+            seq += n;
+        }
+    }
+
+private:
+    int DoDeliverOnceByByte(int len, const u_char* data) {
+        const u_char* data_start = data;
+
+        if ( len <= 0 )
+            return 0;
+
+        for ( ; len > 0; --len, ++data ) {
+            int c = data[0];
+
+            if ( offset >= buf_len ) {
+                if ( ! InitBufferSafe(buf_len * 2) ) {
+                    Weird("contentline_size_exceeded");
+                    offset = buf_len - 1;
+                    EMIT_LINE
+                }
+            }
+
+            switch ( c ) {
+                case '\r':
+                    if ( len > 1 && data[1] == '\n' ) {
+                        --len;
+                        ++data;
+                        last_char = c;
+                        c = data[0];
+                        EMIT_LINE
+                    }
+
+                    else if ( CR_LF_as_EOL & zeek::analyzer::tcp::CR_as_EOL )
+                        EMIT_LINE
+
+                    else
+                        buf[offset++] = c;
+                    break;
+
+                case '\n':
+                    if ( last_char == '\r' ) {
+                        if ( offset == 0 ) {
+                            last_char = c;
+                            break;
+                        }
+                        --offset;
+                        EMIT_LINE
+                    }
+
+                    else if ( CR_LF_as_EOL & zeek::analyzer::tcp::LF_as_EOL )
+                        EMIT_LINE
+
+                    else {
+                        if ( ! suppress_weirds && Conn()->FlagEvent(zeek::SINGULAR_LF) )
+                            Weird("line_terminated_with_single_LF");
+                        buf[offset++] = c;
+                    }
+                    break;
+
+                case '\0':
+                    if ( flag_NULs )
+                        CheckNUL();
+                    else
+                        buf[offset++] = c;
+                    break;
+
+                default: buf[offset++] = c; break;
+            }
+
+            if ( last_char == '\r' )
+                if ( ! suppress_weirds && Conn()->FlagEvent(zeek::SINGULAR_CR) )
+                    Weird("line_terminated_with_single_CR");
+
+            last_char = c;
+        }
+
+        return data - data_start;
+    }
+};
+
+// What a ContentLine_Analyzer passes on: the data, whether it was a plain
+// delivery, and how much of the current input remained.
+using Delivery = std::tuple<std::string, bool, int>;
+
+// Records an analyzer's output. A "PLAIN <n>" line switches the analyzer to
+// plain delivery for the next n bytes, like HTTP does for bodies.
+class Recorder : public zeek::analyzer::OutputHandler {
+public:
+    Recorder(ContentLine_Analyzer* arg_cl, std::vector<Delivery>* arg_out) : cl(arg_cl), out(arg_out) {}
+
+    void DeliverStream(int len, const u_char* data, bool orig) override {
+        std::string s(reinterpret_cast<const char*>(data), len);
+        out->emplace_back(s, cl->IsPlainDelivery(), cl->GetDeliverStreamRemainingLength());
+
+        if ( ! cl->IsPlainDelivery() && s.starts_with("PLAIN ") )
+            cl->SetPlainDelivery(std::stoi(s.substr(6)));
+    }
+
+private:
+    ContentLine_Analyzer* cl;
+    std::vector<Delivery>* out;
+};
+
+} // namespace
+
+TEST_CASE("line splitting matches the byte-by-byte loop") {
+    using zeek::analyzer::tcp::TCP_ApplicationAnalyzer;
+
+    zeek::Packet p;
+    zeek::IPBasedConnKeyPtr kp = std::make_unique<zeek::IPConnKey>();
+    auto conn = std::make_unique<zeek::Connection>(std::move(kp), 0, 0, &p);
+
+    // Pieces to build streams from, covering line terminators, NULs, plain
+    // deliveries starting right after a CR, and lines exceeding the maximum
+    // line length.
+    const std::vector<std::string> pieces = {"a",
+                                             "bcd",
+                                             "GET / HTTP/1.1",
+                                             "\r",
+                                             "\n",
+                                             "\r\n",
+                                             "\n\r",
+                                             std::string(1, '\0'),
+                                             std::string("x\0y\r\n", 5),
+                                             "PLAIN 3\r",
+                                             "PLAIN 5\r\n",
+                                             " ",
+                                             std::string(300, 'L')};
+
+    std::mt19937 rng(42);
+
+    for ( int crlf = 0; crlf <= (zeek::analyzer::tcp::CR_as_EOL | zeek::analyzer::tcp::LF_as_EOL); ++crlf ) {
+        for ( bool flag_nuls : {false, true} ) {
+            for ( bool skip_partial : {false, true} ) {
+                for ( int max_line_length : {200, zeek::analyzer::tcp::DEFAULT_MAX_LINE_LENGTH} ) {
+                    for ( int round = 0; round < 20; ++round ) {
+                        CAPTURE(crlf);
+                        CAPTURE(flag_nuls);
+                        CAPTURE(skip_partial);
+                        CAPTURE(max_line_length);
+                        CAPTURE(round);
+
+                        std::string stream;
+                        while ( stream.size() < 1000 )
+                            stream += pieces[rng() % pieces.size()];
+
+                        // Both analyzers get the same deliveries, split at random points.
+                        std::vector<size_t> splits;
+                        for ( size_t at = 0; at < stream.size(); at += 1 + rng() % 64 )
+                            splits.push_back(at);
+                        splits.push_back(stream.size());
+
+                        std::vector<Delivery> outputs[2];
+
+                        for ( int i = 0; i < 2; ++i ) {
+                            // Without a TCP session adapter, skipping partial
+                            // connections doesn't drop anything.
+                            auto parent = std::make_unique<TCP_ApplicationAnalyzer>(conn.get());
+
+                            ContentLine_Analyzer* cl;
+                            if ( i == 0 )
+                                cl = new Reference_ContentLine_Analyzer(conn.get(), true, max_line_length);
+                            else
+                                cl = new ContentLine_Analyzer(conn.get(), true, max_line_length);
+
+                            cl->SetCRLFAsEOL(crlf);
+                            cl->SetIsNULSensitive(flag_nuls);
+                            cl->SetSkipPartial(skip_partial);
+                            cl->SuppressWeirds(true);
+                            cl->SetOutputHandler(new Recorder(cl, &outputs[i]));
+                            parent->AddSupportAnalyzer(cl);
+
+                            const auto* data = reinterpret_cast<const u_char*>(stream.data());
+                            for ( size_t j = 0; j + 1 < splits.size(); ++j )
+                                cl->NextStream(static_cast<int>(splits[j + 1] - splits[j]), data + splits[j], true);
+
+                            parent->Done();
+                        }
+
+                        CHECK(! outputs[1].empty());
+                        CHECK(outputs[0] == outputs[1]);
+                    }
+                }
+            }
+        }
+    }
+
+    conn->Done();
+}
+
+TEST_SUITE_END();
@@ -119,6 +119,7 @@ void TCP_Endpoint::SetState(EndpointState new_state) {
 
         prev_state = state;
         state = new_state;
+        SizeChanged();
 
         if ( IsOrig() )
             packet_analysis::TCP::TCPAnalyzer::GetStats().ChangeState(prev_state, state, peer->state, peer->state);
@@ -127,6 +128,8 @@ void TCP_Endpoint::SetState(EndpointState new_state) {
     }
 }
 
+void TCP_Endpoint::SizeChanged() { Conn()->InvalidateVal(); }
+
 uint64_t TCP_Endpoint::Size() const {
     if ( prev_state == TCP_ENDPOINT_SYN_SENT && state == TCP_ENDPOINT_RESET && peer->state == TCP_ENDPOINT_INACTIVE &&
          ! NoDataAcked() )
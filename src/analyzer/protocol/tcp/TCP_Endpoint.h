@@ -112,15 +112,25 @@ public:
         return ToFullSeqSpace(tcp_seq_num, wraparounds) - StartSeqI64();
     }
 
-    void InitStartSeq(int64_t seq) { start_seq = seq; }
-    void InitLastSeq(uint32_t seq) { last_seq = seq; }
-    void InitAckSeq(uint32_t seq) { ack_seq = seq; }
+    void InitStartSeq(int64_t seq) {
+        start_seq = seq;
+        SizeChanged();
+    }
+    void InitLastSeq(uint32_t seq) {
+        last_seq = seq;
+        SizeChanged();
+    }
+    void InitAckSeq(uint32_t seq) {
+        ack_seq = seq;
+        SizeChanged();
+    }
 
     void UpdateLastSeq(uint32_t seq) {
         if ( seq < last_seq )
             ++seq_wraps;
 
         last_seq = seq;
+        SizeChanged();
     }
 
     void UpdateAckSeq(uint32_t seq) {
@@ -128,6 +138,7 @@ public:
             ++ack_wraps;
 
         ack_seq = seq;
+        SizeChanged();
     }
 
     // True if none of this endpoint's data has been acknowledged.
@@ -236,6 +247,10 @@ public:
     uint64_t hist_last_SYN, hist_last_FIN, hist_last_RST;
 
 protected:
+    // Called when something that goes into the endpoint's part of the
+    // connection record changes.
+    void SizeChanged();
+
     int64_t start_seq;             // Initial TCP sequence number in host order.
                                    // Signed 64-bit to detect initial sequence wrapping.
                                    // Use StartSeq() accessor if need it in terms of
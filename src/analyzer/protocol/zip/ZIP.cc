@@ -4,31 +4,89 @@
 
 namespace zeek::analyzer::zip {
 
+// Size of the chunks of decompressed output forwarded at a time.
+static constexpr unsigned int unzip_size = 4096;
+
 ZIP_Analyzer::ZIP_Analyzer(Connection* conn, bool orig, Method arg_method)
     : analyzer::tcp::TCP_SupportAnalyzer("ZIP", conn, orig) {
     zip = nullptr;
     zip_status = Z_OK;
     method = arg_method;
 
-    zip = new z_stream;
-    zip->zalloc = nullptr;
-    zip->zfree = nullptr;
-    zip->opaque = nullptr;
-    zip->next_out = nullptr;
-    zip->avail_out = 0;
-    zip->next_in = nullptr;
-    zip->avail_in = 0;
-
-    // "32" is a gross overload hack that means "check it
-    // for whether it's a gzip file".  Sheesh.
-    if ( inflateInit2(zip, MAX_WBITS + 32) != Z_OK ) {
-        Weird("inflate_init_failed");
-        delete zip;
-        zip = nullptr;
+    switch ( method ) {
+        case GZIP:
+        case DEFLATE:
+            zip = new z_stream;
+            zip->zalloc = nullptr;
+            zip->zfree = nullptr;
+            zip->opaque = nullptr;
+            zip->next_out = nullptr;
+            zip->avail_out = 0;
+            zip->next_in = nullptr;
+            zip->avail_in = 0;
+
+            // "32" is a gross overload hack that means "check it
+            // for whether it's a gzip file".  Sheesh.
+            if ( inflateInit2(zip, MAX_WBITS + 32) != Z_OK ) {
+                Weird("inflate_init_failed");
+                delete zip;
+                zip = nullptr;
+            }
+            break;
+
+        case BROTLI:
+#ifdef USE_BROTLI
+            brotli = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+            if ( ! brotli ) {
+                Weird("brotli_init_failed");
+                zip_status = Z_MEM_ERROR;
+            }
+#else
+            zip_status = Z_DATA_ERROR;
+#endif
+            break;
+
+        case ZSTD:
+#ifdef USE_ZSTD
+            zstd = ZSTD_createDStream();
+            if ( ! zstd ) {
+                Weird("zstd_init_failed");
+                zip_status = Z_MEM_ERROR;
+            }
+#else
+            zip_status = Z_DATA_ERROR;
+#endif
+            break;
     }
 }
 
-ZIP_Analyzer::~ZIP_Analyzer() { delete zip; }
+ZIP_Analyzer::~ZIP_Analyzer() {
+    delete zip;
+
+#ifdef USE_BROTLI
+    if ( brotli )
+        BrotliDecoderDestroyInstance(brotli);
+#endif
+
+#ifdef USE_ZSTD
+    if ( zstd )
+        ZSTD_freeDStream(zstd);
+#endif
+}
+
+bool ZIP_Analyzer::MethodSupported(Method method) {
+    switch ( method ) {
+        case GZIP:
+        case DEFLATE: return true;
+#ifdef USE_BROTLI
+        case BROTLI: return true;
+#endif
+#ifdef USE_ZSTD
+        case ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
 
 void ZIP_Analyzer::Done() {
     Analyzer::Done();
@@ -40,10 +98,36 @@ void ZIP_Analyzer::Done() {
 void ZIP_Analyzer::DeliverStream(int len, const u_char* data, bool orig) {
     analyzer::tcp::TCP_SupportAnalyzer::DeliverStream(len, data, orig);
 
-    if ( ! len || zip_status != Z_OK )
+    if ( ! len || zip_status != Z_OK || limit_reached )
         return;
 
-    static unsigned int unzip_size = 4096;
+    switch ( method ) {
+        case GZIP:
+        case DEFLATE:
+            if ( zip )
+                Inflate(len, data);
+            break;
+
+        case BROTLI: DecompressBrotli(len, data); break;
+        case ZSTD: DecompressZstd(len, data); break;
+    }
+}
+
+bool ZIP_Analyzer::Output(size_t len, const u_char* data) {
+    if ( len > output_limit - output_bytes ) {
+        len = output_limit - output_bytes;
+        limit_reached = true;
+    }
+
+    if ( len ) {
+        output_bytes += len;
+        ForwardStream(static_cast<int>(len), data, IsOrig());
+    }
+
+    return ! limit_reached;
+}
+
+void ZIP_Analyzer::Inflate(int len, const u_char* data) {
     auto unzipbuf = std::make_unique<Bytef[]>(unzip_size);
 
     int allow_restart = 1;
@@ -64,8 +148,8 @@ void ZIP_Analyzer::DeliverStream(int len, const u_char* data, bool orig) {
             allow_restart = 0;
 
             int have = unzip_size - zip->avail_out;
-            if ( have )
-                ForwardStream(have, unzipbuf.get(), IsOrig());
+            if ( have && ! Output(have, unzipbuf.get()) )
+                return;
 
             if ( zip_status == Z_STREAM_END ) {
                 inflateEnd(zip);
@@ -99,4 +183,70 @@ void ZIP_Analyzer::DeliverStream(int len, const u_char* data, bool orig) {
     }
 }
 
+void ZIP_Analyzer::DecompressBrotli(int len, const u_char* data) {
+#ifdef USE_BROTLI
+    u_char buf[unzip_size];
+    size_t avail_in = len;
+    const uint8_t* next_in = data;
+
+    while ( true ) {
+        size_t avail_out = sizeof(buf);
+        uint8_t* next_out = buf;
+
+        auto rc = BrotliDecoderDecompressStream(brotli, &avail_in, &next_in, &avail_out, &next_out, nullptr);
+
+        if ( rc == BROTLI_DECODER_RESULT_ERROR ) {
+            Weird("brotli_decompression_failed");
+            zip_status = Z_DATA_ERROR;
+            return;
+        }
+
+        if ( ! Output(sizeof(buf) - avail_out, buf) )
+            return;
+
+        if ( rc == BROTLI_DECODER_RESULT_SUCCESS ) {
+            zip_status = Z_STREAM_END;
+            return;
+        }
+
+        if ( rc == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT )
+            return;
+    }
+#endif
+}
+
+void ZIP_Analyzer::DecompressZstd(int len, const u_char* data) {
+#ifdef USE_ZSTD
+    u_char buf[unzip_size];
+    ZSTD_inBuffer in = {data, static_cast<size_t>(len), 0};
+
+    while ( true ) {
+        ZSTD_outBuffer out = {buf, sizeof(buf), 0};
+        size_t rc = ZSTD_decompressStream(zstd, &out, &in);
+
+        if ( ZSTD_isError(rc) ) {
+            Weird("zstd_decompression_failed");
+            zip_status = Z_DATA_ERROR;
+            return;
+        }
+
+        if ( ! Output(out.pos, buf) )
+            return;
+
+        if ( rc == 0 ) {
+            // End of a frame. Further frames may follow.
+            if ( in.pos == in.size )
+                return;
+
+            continue;
+        }
+
+        // A full output buffer may mean there's more to flush even when all
+        // input has been consumed.
+        if ( in.pos == in.size && out.pos < out.size )
+            return;
+    }
+#endif
+}
+
 } // namespace zeek::analyzer::zip
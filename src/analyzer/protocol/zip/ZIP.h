@@ -2,15 +2,27 @@
 
 #pragma once
 
+#include "zeek/zeek-config.h"
+
 #include <zlib.h>
+#include <cstdint>
+#include <limits>
 
 #include "zeek/analyzer/protocol/tcp/TCP.h"
 
+#ifdef USE_BROTLI
+#include <brotli/decode.h>
+#endif
+
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
 namespace zeek::analyzer::zip {
 
 class ZIP_Analyzer final : public analyzer::tcp::TCP_SupportAnalyzer {
 public:
-    enum Method : uint8_t { GZIP, DEFLATE };
+    enum Method : uint8_t { GZIP, DEFLATE, BROTLI, ZSTD };
 
     ZIP_Analyzer(Connection* conn, bool orig, Method method = GZIP);
     ~ZIP_Analyzer() override;
@@ -19,11 +31,52 @@ public:
 
     void DeliverStream(int len, const u_char* data, bool orig) override;
 
+    /**
+     * Returns true if this Zeek build can decompress the given method.
+     */
+    static bool MethodSupported(Method method);
+
+    /**
+     * Limits the total number of decompressed bytes the analyzer forwards.
+     * Once the limit has been reached, it stops decompressing for good.
+     */
+    void SetOutputLimit(uint64_t limit) { output_limit = limit; }
+
+    /**
+     * Returns the number of decompressed bytes forwarded so far.
+     */
+    uint64_t OutputBytes() const { return output_bytes; }
+
+    /**
+     * Returns true if decompression stopped because of the output limit.
+     */
+    bool OutputLimitReached() const { return limit_reached; }
+
 protected:
     enum : uint8_t { NONE, ZIP_OK, ZIP_FAIL };
+
+    void Inflate(int len, const u_char* data);
+    void DecompressBrotli(int len, const u_char* data);
+    void DecompressZstd(int len, const u_char* data);
+
+    // Forwards decompressed data, cutting it off at the output limit.
+    // Returns false once the limit has been reached.
+    bool Output(size_t len, const u_char* data);
+
     z_stream* zip;
     int zip_status;
     Method method;
+    uint64_t output_bytes = 0;
+    uint64_t output_limit = std::numeric_limits<uint64_t>::max();
+    bool limit_reached = false;
+
+#ifdef USE_BROTLI
+    BrotliDecoderState* brotli = nullptr;
+#endif
+
+#ifdef USE_ZSTD
+    ZSTD_DStream* zstd = nullptr;
+#endif
 };
 
 } // namespace zeek::analyzer::zip
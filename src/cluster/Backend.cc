@@ -39,6 +39,11 @@ void detail::LocalEventHandlingStrategy::DoProcessLocalEvent(EventHandlerPtr h,
     zeek::event_mgr.Enqueue(h, std::move(args));
 }
 
+bool detail::LocalEventHandlingStrategy::DoProcessLocalEventFromThread(EventHandlerPtr h,
+                                                                       std::function<zeek::Args()> make_args) {
+    return zeek::event_mgr.EnqueueFromThread(h, std::move(make_args), util::detail::SOURCE_LOCAL, false);
+}
+
 // Backend errors are raised via a generic Cluster::Backend::error(tag, message) event.
 void detail::LocalEventHandlingStrategy::DoProcessError(std::string_view tag, std::string_view message) {
     if ( Cluster::Backend::error )
@@ -206,6 +211,10 @@ void Backend::EnqueueEvent(EventHandlerPtr h, zeek::Args args) {
     event_handling_strategy->ProcessLocalEvent(h, std::move(args));
 }
 
+bool Backend::EnqueueEventFromThread(EventHandlerPtr h, std::function<zeek::Args()> make_args) {
+    return event_handling_strategy->ProcessLocalEventFromThread(h, std::move(make_args));
+}
+
 bool Backend::ProcessEvent(std::string_view topic, cluster::Event e) {
     return event_handling_strategy->ProcessEvent(topic, std::move(e));
 }
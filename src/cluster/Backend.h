@@ -4,6 +4,7 @@
 
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <optional>
 #include <span>
@@ -72,6 +73,20 @@ public:
      */
     void ProcessLocalEvent(EventHandlerPtr h, zeek::Args args) { DoProcessLocalEvent(h, std::move(args)); }
 
+    /**
+     * Like ProcessLocalEvent(), for calling from a backend's own thread.
+     * As Vals can only be created on the main thread, the event's arguments
+     * are passed as a function producing them there.
+     *
+     * @param h The event handler to use.
+     * @param make_args Produces the event arguments on the main thread.
+     *
+     * @return false if the event could not be queued.
+     */
+    bool ProcessLocalEventFromThread(EventHandlerPtr h, std::function<zeek::Args()> make_args) {
+        return DoProcessLocalEventFromThread(h, std::move(make_args));
+    }
+
     /**
      * Process an error.
      *
@@ -99,6 +114,20 @@ private:
      */
     virtual void DoProcessLocalEvent(EventHandlerPtr h, zeek::Args args) = 0;
 
+    /**
+     * Hook method for implementing ProcessLocalEventFromThread().
+     *
+     * @param h The event handler to use.
+     * @param make_args Produces the event arguments on the main thread.
+     *
+     * @return false if the event could not be queued. The default
+     * implementation doesn't queue anything, leaving it to the backend to
+     * take another route to the main thread.
+     */
+    virtual bool DoProcessLocalEventFromThread(EventHandlerPtr h, std::function<zeek::Args()> make_args) {
+        return false;
+    }
+
     /**
      * Hook method for implementing ProcessError().
      *
@@ -115,6 +144,7 @@ class LocalEventHandlingStrategy : public EventHandlingStrategy {
 private:
     bool DoProcessEvent(std::string_view topic, cluster::Event e) override;
     void DoProcessLocalEvent(EventHandlerPtr h, zeek::Args args) override;
+    bool DoProcessLocalEventFromThread(EventHandlerPtr h, std::function<zeek::Args()> make_args) override;
     void DoProcessError(std::string_view tag, std::string_view message) override;
 };
 
@@ -304,6 +334,20 @@ protected:
      */
     void EnqueueEvent(EventHandlerPtr h, zeek::Args args);
 
+    /**
+     * Like EnqueueEvent(), for calling from a backend's own thread. The
+     * function producing the event's arguments runs on the main thread and
+     * must only capture plain data.
+     *
+     * @param h The event handler.
+     * @param make_args Produces the event arguments.
+     *
+     * @return false if the event could not be queued because Zeek's ingress
+     * queue for events from other threads is full or not open, or because
+     * the event handling strategy doesn't support queueing from threads.
+     */
+    bool EnqueueEventFromThread(EventHandlerPtr h, std::function<zeek::Args()> make_args);
+
     /**
      * Process a cluster event.
      *
@@ -10,6 +10,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <string>
@@ -904,22 +905,41 @@ void ZeroMQBackend::HandleXSubMessages(const std::vector<MultipartMessage>& msgs
 
 void ZeroMQBackend::HandleMonitoringMessages(const std::vector<MultipartMessage>& msgs) {
     for ( const auto& msg : msgs ) {
-        if ( msg.size() == 2 ) {
-            // Concatenate the frames of the monitoring event into a single string
-            // and copy its content into the BackendMessage payload. The DoProcessBackendMessage()
-            // implementation understands how to unpack this again.
-            std::string str = msg[0].to_string() + msg[1].to_string();
-            byte_buffer payload{reinterpret_cast<std::byte*>(str.data()),
-                                reinterpret_cast<std::byte*>(str.data()) + str.size()};
-
-            auto qm = BackendMessage{static_cast<int>(ZeroMQBackendMessageTag::MonitoringEvent), std::move(payload)};
-            OnLoop()->QueueForProcessing(std::move(qm), zeek::detail::QueueFlag::Force);
-        }
-        else {
-            ZEROMQ_THREAD_PRINTF("mon: error: expected 2 parts, have %zu!\n", msg.size());
+        // https://libzmq.readthedocs.io/en/latest/zmq_socket_monitor.html
+        if ( msg.size() != 2 || msg[0].size() != 6 ) {
+            ZEROMQ_THREAD_PRINTF("mon: error: expected 2 parts with a 6 byte event, have %zu!\n", msg.size());
             total_msg_errors->Inc();
             continue;
         }
+
+        if ( ! event_monitoring_event )
+            continue;
+
+        uint16_t event_number;
+        uint32_t event_value;
+        memcpy(&event_number, msg[0].data<std::byte>(), sizeof(event_number));
+        memcpy(&event_value, msg[0].data<std::byte>() + 2, sizeof(event_value));
+
+        // The event goes straight into Zeek's event queue, with its Vals
+        // getting created once the main thread picks it up.
+        auto make_args = [event_number, event_value, addr = msg[1].to_string()] {
+            return zeek::Args{val_mgr->Count(event_number), val_mgr->Count(event_value),
+                              zeek::make_intrusive<zeek::StringVal>(addr)};
+        };
+
+        if ( EnqueueEventFromThread(event_monitoring_event, std::move(make_args)) )
+            continue;
+
+        // If Zeek's ingress queue is full, take the slower route through the
+        // onloop queue instead. Monitoring events must not get lost. The
+        // DoProcessBackendMessage() implementation understands how to unpack
+        // the concatenated frames again.
+        std::string str = msg[0].to_string() + msg[1].to_string();
+        byte_buffer payload{reinterpret_cast<std::byte*>(str.data()),
+                            reinterpret_cast<std::byte*>(str.data()) + str.size()};
+
+        auto qm = BackendMessage{static_cast<int>(ZeroMQBackendMessageTag::MonitoringEvent), std::move(payload)};
+        OnLoop()->QueueForProcessing(std::move(qm), zeek::detail::QueueFlag::Force);
     }
 }
 
@@ -1103,8 +1123,10 @@ bool ZeroMQBackend::DoProcessBackendMessage(int tag, byte_buffer_span payload) {
     }
     else if ( tag == ZeroMQBackendMessageTag::MonitoringEvent && payload.size() >= 6 ) {
         // https://libzmq.readthedocs.io/en/latest/zmq_socket_monitor.html
-        uint16_t event_number = *reinterpret_cast<const uint16_t*>(payload.data());
-        uint32_t event_value = *reinterpret_cast<const uint32_t*>(payload.data() + 2);
+        uint16_t event_number;
+        uint32_t event_value;
+        memcpy(&event_number, payload.data(), sizeof(event_number));
+        memcpy(&event_value, payload.data() + 2, sizeof(event_value));
         const char* addr_ptr = reinterpret_cast<const char*>(payload.data() + 6);
         std::string addr = {addr_ptr, payload.size() - 6};
         ZEROMQ_DEBUG("BackendMessage: monitoring_event 0x%x with value value 0x%x for socket %s", event_number,
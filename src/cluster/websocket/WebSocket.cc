@@ -89,6 +89,10 @@ private:
      */
     void DoProcessLocalEvent(zeek::EventHandlerPtr h, zeek::Args args) override {}
 
+    bool DoProcessLocalEventFromThread(zeek::EventHandlerPtr h, std::function<zeek::Args()> make_args) override {
+        return true;
+    }
+
     /**
      * Send errors directly to the client.
      */
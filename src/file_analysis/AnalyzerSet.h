@@ -86,6 +86,11 @@ public:
      */
     void DrainModifications();
 
+    /**
+     * @return true if no analyzers are attached nor queued for addition.
+     */
+    bool Empty() const { return analyzer_map.Length() == 0 && mod_queue.empty(); }
+
     // Iterator support
     using iterator = zeek::DictIterator<file_analysis::Analyzer>;
     using const_iterator = const iterator;
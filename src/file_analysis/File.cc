@@ -2,6 +2,8 @@
 
 #include "zeek/file_analysis/File.h"
 
+#include <algorithm>
+#include <cstring>
 #include <utility>
 
 #include "zeek/Conn.h"
@@ -263,9 +265,8 @@ void File::InferMetadata() {
         if ( bof_buffer.size == 0 )
             return;
 
-        String* bs = concatenate(bof_buffer.chunks);
-        val->Assign(bof_buffer_idx, bs);
-        bof_buffer_val = val->GetField(bof_buffer_idx);
+        PublishBOF();
+        bof_buffer_val = bof_buffer.published;
     }
 
     if ( ! FileEventAvailable(file_sniff) )
@@ -287,13 +288,34 @@ void File::InferMetadata() {
     FileEvent(file_sniff, {val, std::move(meta)});
 }
 
+File::BOF_Buffer::~BOF_Buffer() { delete[] data; }
+
+const u_char* File::BOF_Buffer::Bytes() const { return published ? published->Bytes() : data; }
+
 bool File::BufferBOF(const u_char* data, uint64_t len) {
     if ( bof_buffer.full )
         return false;
 
     uint64_t desired_size = LookupFieldDefaultCount(bof_buffer_size_idx);
 
-    bof_buffer.chunks.push_back(new String(data, len, false));
+    // The buffer is contiguous and keeps room for a final NUL, so that it
+    // can become the bof_buffer field's string as is. Only the chunk that
+    // fills it may need to grow it.
+    if ( bof_buffer.size + len + 1 > bof_buffer.capacity ) {
+        auto capacity = std::max(bof_buffer.size + len, desired_size) + 1;
+        auto* grown = new u_char[capacity];
+
+        if ( bof_buffer.size > 0 )
+            memcpy(grown, bof_buffer.data, bof_buffer.size);
+
+        delete[] bof_buffer.data;
+        bof_buffer.data = grown;
+        bof_buffer.capacity = capacity;
+    }
+
+    if ( len > 0 )
+        memcpy(bof_buffer.data + bof_buffer.size, data, len);
+
     bof_buffer.size += len;
 
     if ( bof_buffer.size < desired_size )
@@ -301,15 +323,44 @@ bool File::BufferBOF(const u_char* data, uint64_t len) {
 
     bof_buffer.full = true;
 
-    if ( bof_buffer.size > 0 ) {
-        String* bs = concatenate(bof_buffer.chunks);
-        val->Assign(bof_buffer_idx, bs);
-    }
+    if ( bof_buffer.size > 0 )
+        PublishBOF();
 
     return false;
 }
 
+void File::PublishBOF() {
+    if ( bof_buffer.published || ! bof_buffer.data )
+        return;
+
+    bof_buffer.data[bof_buffer.size] = '\0';
+    bof_buffer.published = make_intrusive<StringVal>(new String(true, bof_buffer.data, bof_buffer.size));
+    bof_buffer.data = nullptr;
+    bof_buffer.capacity = 0;
+
+    val->Assign(bof_buffer_idx, bof_buffer.published);
+}
+
+bool File::SkipBOF() const {
+    static const auto& max_size = id::find("file_sniff_max_size");
+    static const auto& skip_sources = id::find("file_sniff_skip_sources");
+
+    auto limit = max_size->GetVal()->AsCount();
+
+    if ( limit > 0 && val->HasRawField(total_bytes_idx) && val->GetFieldAs<CountVal>(total_bytes_idx) > limit )
+        return true;
+
+    auto* sources = skip_sources->GetVal()->AsTableVal();
+    return sources->Size() > 0 && sources->FindOrDefault(make_intrusive<StringVal>(GetSource()));
+}
+
 void File::DeliverStream(const u_char* data, uint64_t len) {
+    if ( ! bof_buffer.full && bof_buffer.size == 0 && SkipBOF() ) {
+        DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Skipping BOF buffering and metadata inference", id.c_str());
+        bof_buffer.full = true;
+        did_metadata_inference = true;
+    }
+
     bool bof_was_full = bof_buffer.full;
     // Buffer enough data for the BOF buffer
     BufferBOF(data, len);
@@ -328,25 +379,19 @@ void File::DeliverStream(const u_char* data, uint64_t len) {
         if ( ! a->GotStreamDelivery() ) {
             DBG_LOG(DBG_FILE_ANALYSIS, "skipping stream delivery to analyzer %s",
                     file_mgr->GetComponentName(a->Tag()).c_str());
-            int num_bof_chunks_behind = bof_buffer.chunks.size();
+            uint64_t bof_bytes_behind = bof_buffer.size;
 
             if ( ! bof_was_full )
                 // We just added a chunk to the BOF buffer, don't count it
                 // as it will get delivered on its own.
-                num_bof_chunks_behind -= 1;
-
-            uint64_t bytes_delivered = 0;
+                bof_bytes_behind -= len;
 
             // Catch this analyzer up with the BOF buffer.
-            for ( int i = 0; i < num_bof_chunks_behind; ++i ) {
-                if ( ! a->Skipping() ) {
-                    if ( ! a->DeliverStream(bof_buffer.chunks[i]->Bytes(), bof_buffer.chunks[i]->Len()) ) {
-                        a->SetSkip(true);
-                        analyzers.QueueRemove(a->Tag(), a->GetArgs());
-                    }
+            if ( bof_bytes_behind > 0 && ! a->Skipping() ) {
+                if ( ! a->DeliverStream(bof_buffer.Bytes(), bof_bytes_behind) ) {
+                    a->SetSkip(true);
+                    analyzers.QueueRemove(a->Tag(), a->GetArgs());
                 }
-
-                bytes_delivered += bof_buffer.chunks[i]->Len();
             }
 
             a->SetGotStreamDelivery();
@@ -17,7 +17,9 @@ class Connection;
 class EventHandlerPtr;
 class RecordVal;
 class RecordType;
+class StringVal;
 using RecordValPtr = IntrusivePtr<RecordVal>;
+using StringValPtr = IntrusivePtr<StringVal>;
 using RecordTypePtr = IntrusivePtr<RecordType>;
 
 namespace file_analysis {
@@ -100,6 +102,13 @@ public:
      */
     bool IsComplete() const;
 
+    /**
+     * @return false once further content would go unused: metadata
+     * inference is done and no analyzers are attached. Script handlers
+     * may still attach analyzers in response to the file's events.
+     */
+    bool NeedsContent() const { return ! did_metadata_inference || ! analyzers.Empty(); }
+
     /**
      * Create a timer to be dispatched after the amount of time indicated by
      * the "timeout_interval" field of the #val record in order to check if
@@ -265,6 +274,18 @@ protected:
      */
     bool BufferBOF(const u_char* data, uint64_t len);
 
+    /**
+     * Hands the content of the BOF buffer over to the \c bof_buffer field
+     * of #val, without copying it.
+     */
+    void PublishBOF();
+
+    /**
+     * Returns true if policy rules out BOF buffering and metadata inference
+     * for the file, based on its source and total size.
+     */
+    bool SkipBOF() const;
+
     /**
      * Does metadata inference (e.g. mime type detection via file
      * magic signatures) using data in the BOF (beginning-of-file) buffer
@@ -332,14 +353,18 @@ protected:
 
     struct BOF_Buffer {
         BOF_Buffer() = default;
-        ~BOF_Buffer() {
-            for ( auto* chunk : chunks )
-                delete chunk;
-        }
+        ~BOF_Buffer();
+
+        BOF_Buffer(const BOF_Buffer&) = delete;
+        BOF_Buffer& operator=(const BOF_Buffer&) = delete;
+
+        const u_char* Bytes() const;
 
         bool full = false;
         uint64_t size = 0;
-        String::CVec chunks;
+        uint64_t capacity = 0;
+        byte_vec data = nullptr; // The content while it's still being buffered.
+        StringValPtr published;  // The content once handed over to the script layer.
     } bof_buffer; /**< Beginning of file buffer. */
 
     zeek::detail::WeirdStateMap weird_state;
@@ -0,0 +1,227 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/file_analysis/ThreadedAnalyzer.h"
+
+#include <cinttypes>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "zeek/Flare.h"
+#include "zeek/Reporter.h"
+#include "zeek/Val.h"
+#include "zeek/file_analysis/File.h"
+#include "zeek/file_analysis/WorkerThread.h"
+#include "zeek/iosource/IOSource.h"
+#include "zeek/iosource/Manager.h"
+#include "zeek/util.h"
+
+#include "const.bif.netvar_h" // for file_analysis_worker_*
+
+namespace zeek::file_analysis {
+
+namespace detail {
+
+/**
+ * The functions that threaded analyzers scheduled for the main thread, in
+ * the order they were scheduled. The IO loop gets woken up through a flare
+ * when there's something to run.
+ */
+class MainThreadQueue : public iosource::IOSource {
+public:
+    MainThreadQueue() {
+        iosource_mgr->Register(this, true, false);
+
+        if ( ! iosource_mgr->RegisterFd(flare.FD(), this) )
+            reporter->FatalError("Failed to register file analysis worker flare");
+    }
+
+    /**
+     * Appends a function. Safe to call from any thread.
+     */
+    void Push(ThreadedAnalyzer* a, std::function<void()> f) {
+        bool was_empty;
+
+        {
+            std::scoped_lock lock(mtx);
+            was_empty = queue.empty();
+            queue.push_back({a, std::move(f)});
+        }
+
+        if ( was_empty )
+            flare.Fire();
+    }
+
+    /**
+     * Runs all functions queued so far. Main thread only.
+     */
+    void Run() {
+        while ( true ) {
+            Entry e;
+
+            {
+                std::scoped_lock lock(mtx);
+
+                if ( queue.empty() )
+                    return;
+
+                e = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            // Outside of the lock, the function may well lead to more
+            // functions getting queued.
+            e.f();
+        }
+    }
+
+    /**
+     * Drops all functions an analyzer has queued. Main thread only.
+     */
+    void Discard(ThreadedAnalyzer* a) {
+        std::scoped_lock lock(mtx);
+        std::erase_if(queue, [a](const Entry& e) { return e.a == a; });
+    }
+
+    double GetNextTimeout() override { return -1.0; }
+
+    void Process() override {
+        // Extinguish first: a worker finding the queue empty afterwards
+        // fires the flare again.
+        flare.Extinguish();
+        Run();
+    }
+
+    const char* Tag() override { return "FileAnalysisWorkers"; }
+
+private:
+    struct Entry {
+        ThreadedAnalyzer* a = nullptr;
+        std::function<void()> f;
+    };
+
+    std::mutex mtx;
+    std::deque<Entry> queue;
+    zeek::detail::Flare flare;
+};
+
+struct AnalyzerChunk {
+    ThreadedAnalyzer* a;
+    std::vector<u_char> data;
+};
+
+/**
+ * A background thread running the analyzers of the files assigned to it.
+ * Content for any one file is processed in the order it was delivered.
+ */
+class AnalyzerWorker : public WorkerThread<AnalyzerChunk> {
+public:
+    explicit AnalyzerWorker(size_t max_queued_bytes)
+        : WorkerThread("zk/files", max_queued_bytes, [](AnalyzerChunk& c) { Process(c); }) {}
+
+    /**
+     * Queues a copy of the given content for the analyzer. Never blocks.
+     *
+     * @return false if the thread has too much content queued already to
+     * take it.
+     */
+    bool Feed(ThreadedAnalyzer* a, const u_char* data, uint64_t len) {
+        return TryPush({a, std::vector<u_char>(data, data + len)}, len, &a->pending);
+    }
+
+    /**
+     * Blocks until all content queued for the given analyzer is processed.
+     */
+    void Wait(ThreadedAnalyzer* a) { WorkerThread::Wait(&a->pending); }
+
+private:
+    static void Process(AnalyzerChunk& c) {
+        if ( ! c.a->stopped.load(std::memory_order_relaxed) && ! c.a->ProcessStream(c.data.data(), c.data.size()) )
+            c.a->stopped.store(true, std::memory_order_release);
+    }
+};
+
+// Declared before the workers so that it outlives them at shutdown.
+static std::unique_ptr<MainThreadQueue> main_thread_queue;
+static std::vector<std::unique_ptr<AnalyzerWorker>> analyzer_workers;
+
+// Returns the thread for a new analyzer of the given file, or nil if
+// analysis happens inline. Files get spread across the threads by their
+// ID, so that all of a file's analyzers end up on the same one.
+static AnalyzerWorker* assign_analyzer_worker(const File* file) {
+    if ( BifConst::file_analysis_worker_threads == 0 )
+        return nullptr;
+
+    if ( analyzer_workers.empty() ) {
+        main_thread_queue = std::make_unique<MainThreadQueue>();
+
+        for ( zeek_uint_t i = 0; i < BifConst::file_analysis_worker_threads; ++i )
+            analyzer_workers.emplace_back(
+                std::make_unique<AnalyzerWorker>(BifConst::file_analysis_worker_max_queued_bytes));
+    }
+
+    auto h = std::hash<std::string>{}(file->GetID());
+    return analyzer_workers[h % analyzer_workers.size()].get();
+}
+
+} // namespace detail
+
+ThreadedAnalyzer::ThreadedAnalyzer(zeek::Tag arg_tag, RecordValPtr arg_args, File* arg_file)
+    : Analyzer(std::move(arg_tag), std::move(arg_args), arg_file), worker(detail::assign_analyzer_worker(arg_file)) {}
+
+ThreadedAnalyzer::~ThreadedAnalyzer() {
+    // Derived classes are gone already, but Done() ran before and nothing
+    // got delivered since.
+    if ( worker ) {
+        worker->Wait(this);
+        detail::main_thread_queue->Discard(this);
+    }
+}
+
+bool ThreadedAnalyzer::DeliverStream(const u_char* data, uint64_t len) {
+    if ( stopped.load(std::memory_order_acquire) )
+        return false;
+
+    if ( ! worker ) {
+        if ( ! ProcessStream(data, len) )
+            stopped = true;
+
+        return ! stopped;
+    }
+
+    if ( ! worker->Feed(this, data, len) ) {
+        // Rather than holding up packet processing until the thread catches
+        // up, give up on the file. Without its content, the analyzer can't
+        // continue either way.
+        Weird("file_analysis_worker_queue_full", util::fmt("%" PRIu64 " bytes", len));
+        stopped = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool ThreadedAnalyzer::EndOfFile() {
+    Flush();
+    return true;
+}
+
+void ThreadedAnalyzer::Done() { Flush(); }
+
+void ThreadedAnalyzer::RunOnMainThread(std::function<void()> f) {
+    if ( worker )
+        detail::main_thread_queue->Push(this, std::move(f));
+    else
+        f();
+}
+
+void ThreadedAnalyzer::Flush() {
+    if ( ! worker )
+        return;
+
+    worker->Wait(this);
+    detail::main_thread_queue->Run();
+}
+
+} // namespace zeek::file_analysis
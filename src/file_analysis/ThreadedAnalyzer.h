@@ -0,0 +1,101 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+
+#include "zeek/file_analysis/Analyzer.h"
+
+namespace zeek::file_analysis {
+
+namespace detail {
+class AnalyzerWorker;
+}
+
+/**
+ * Base class for file analyzers that can parse their input on a background
+ * thread. With file_analysis_worker_threads set to a non-zero value, content
+ * delivered to such an analyzer is copied and queued to one of a pool of
+ * worker threads, which calls ProcessStream(). All threaded analyzers of a
+ * file share the same thread, so a file's content gets processed in order.
+ *
+ * ProcessStream() must not touch any Vals, nor anything else owned by the
+ * main thread. Derived classes instead hand functions doing that to
+ * RunOnMainThread(), which the main thread runs in the order they were
+ * scheduled, either from the IO loop or at the latest when the analyzer
+ * reaches the end of its file or gets removed.
+ *
+ * Without worker threads, ProcessStream() runs right away and so do
+ * functions passed to RunOnMainThread().
+ */
+class ThreadedAnalyzer : public Analyzer {
+public:
+    ~ThreadedAnalyzer() override;
+
+    /**
+     * Queues the data for ProcessStream(), or processes it right away if
+     * there's no worker thread. If the worker thread has too much content
+     * queued already, raises a file_analysis_worker_queue_full weird and
+     * stops the analyzer instead.
+     *
+     * @return False once ProcessStream() has returned false, or the
+     * analyzer got stopped.
+     */
+    bool DeliverStream(const u_char* data, uint64_t len) override;
+
+    /**
+     * Waits for all queued content to be processed and runs the functions
+     * scheduled for the main thread. This wait is bounded by the content
+     * queued to the analyzer's thread, at most
+     * file_analysis_worker_max_queued_bytes.
+     */
+    bool EndOfFile() override;
+
+    /**
+     * Same as EndOfFile(), for analyzers getting removed early.
+     */
+    void Done() override;
+
+protected:
+    friend class detail::AnalyzerWorker;
+
+    /**
+     * Constructor. See file_analysis::Analyzer.
+     */
+    ThreadedAnalyzer(zeek::Tag arg_tag, RecordValPtr arg_args, File* arg_file);
+
+    /**
+     * Parses the next chunk of the file's content. Runs on a worker thread
+     * if there are any.
+     *
+     * @return False if the analyzer doesn't need any further content.
+     */
+    virtual bool ProcessStream(const u_char* data, uint64_t len) = 0;
+
+    /**
+     * Schedules a function to run on the main thread, after all functions
+     * scheduled before by any analyzer of the same file. May be called from
+     * ProcessStream() only.
+     */
+    void RunOnMainThread(std::function<void()> f);
+
+    /**
+     * Blocks until all content delivered so far is processed, then runs
+     * the functions scheduled for the main thread.
+     */
+    void Flush();
+
+private:
+    detail::AnalyzerWorker* worker = nullptr;
+
+    // Number of chunks queued and not yet processed. Only accessed under
+    // the worker's lock.
+    size_t pending = 0;
+
+    // Set once ProcessStream() returned false.
+    std::atomic<bool> stopped = false;
+};
+
+} // namespace zeek::file_analysis
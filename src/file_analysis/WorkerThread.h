@@ -0,0 +1,190 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <csignal>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "zeek/util.h"
+
+namespace zeek::file_analysis::detail {
+
+/**
+ * A background thread working off a queue of items in the order they were
+ * queued, for file analyzers that move work off the main thread. Each item
+ * comes with the number of content bytes it holds, and the thread only
+ * takes so many of those at a time.
+ *
+ * Callers can have the thread count their items in a counter of their own,
+ * which goes back to zero once all of them are done. Counters are only
+ * touched under the thread's lock.
+ */
+template<typename Item>
+class WorkerThread {
+public:
+    /**
+     * Constructor. Starts the thread.
+     *
+     * @param name The name for the thread, as shown by tools like top.
+     *
+     * @param arg_max_queued_bytes The number of bytes the queued items may
+     * hold at most. An item that's larger on its own still gets queued once
+     * the queue is empty.
+     *
+     * @param arg_process Called on the thread for every item, without the
+     * lock held.
+     */
+    WorkerThread(const char* name, size_t arg_max_queued_bytes, std::function<void(Item&)> arg_process)
+        : max_queued_bytes(arg_max_queued_bytes), process(std::move(arg_process)), thread([this] { Run(); }) {
+        if constexpr ( std::is_same_v<std::thread::native_handle_type, pthread_t> )
+            util::detail::set_thread_name(name, reinterpret_cast<pthread_t>(thread.native_handle()));
+    }
+
+    /**
+     * Destructor. Lets the thread finish all queued items, then joins it.
+     */
+    ~WorkerThread() {
+        {
+            std::scoped_lock lock(mtx);
+            done = true;
+        }
+
+        work_cond.notify_one();
+        thread.join();
+    }
+
+    /**
+     * Queues an item. Blocks while the thread has too much content queued
+     * already.
+     *
+     * @param item The item.
+     *
+     * @param bytes The number of content bytes the item holds.
+     *
+     * @param pending If given, a counter to increment until the item is done.
+     */
+    void Push(Item item, size_t bytes, size_t* pending = nullptr) {
+        {
+            std::unique_lock lock(mtx);
+            idle_cond.wait(lock, [this, bytes] { return HasRoom(bytes); });
+            Append(std::move(item), bytes, pending);
+        }
+
+        work_cond.notify_one();
+    }
+
+    /**
+     * Like Push(), but returns right away if the item's content doesn't fit
+     * into what remains of the limit. Unlike with Push(), that includes items
+     * larger than the limit on their own.
+     *
+     * @return false if the item wasn't queued.
+     */
+    bool TryPush(Item item, size_t bytes, size_t* pending = nullptr) {
+        {
+            std::scoped_lock lock(mtx);
+
+            if ( queued_bytes + bytes > max_queued_bytes )
+                return false;
+
+            Append(std::move(item), bytes, pending);
+        }
+
+        work_cond.notify_one();
+        return true;
+    }
+
+    /**
+     * Blocks until all items counted in the given counter are done.
+     */
+    void Wait(const size_t* pending) {
+        std::unique_lock lock(mtx);
+        idle_cond.wait(lock, [pending] { return *pending == 0; });
+    }
+
+    /**
+     * Blocks until all items queued so far are done.
+     */
+    void Drain() {
+        std::unique_lock lock(mtx);
+        idle_cond.wait(lock, [this] { return queue.empty() && ! busy; });
+    }
+
+private:
+    struct Entry {
+        Item item;
+        size_t bytes;
+        size_t* pending;
+    };
+
+    bool HasRoom(size_t bytes) const { return queued_bytes == 0 || queued_bytes + bytes <= max_queued_bytes; }
+
+    void Append(Item item, size_t bytes, size_t* pending) {
+        queued_bytes += bytes;
+
+        if ( pending )
+            ++*pending;
+
+        queue.push_back({std::move(item), bytes, pending});
+    }
+
+    void Run() {
+#ifndef _MSC_VER
+        // Signals get handled in the main thread, see BasicThread::launcher().
+        sigset_t mask_set;
+        sigfillset(&mask_set);
+        sigdelset(&mask_set, SIGFPE);
+        sigdelset(&mask_set, SIGILL);
+        sigdelset(&mask_set, SIGSEGV);
+        sigdelset(&mask_set, SIGBUS);
+        pthread_sigmask(SIG_BLOCK, &mask_set, nullptr);
+#endif
+
+        std::unique_lock lock(mtx);
+
+        while ( true ) {
+            work_cond.wait(lock, [this] { return done || ! queue.empty(); });
+
+            if ( queue.empty() )
+                return;
+
+            auto e = std::move(queue.front());
+            queue.pop_front();
+            busy = true;
+
+            lock.unlock();
+            process(e.item);
+            lock.lock();
+
+            busy = false;
+            queued_bytes -= e.bytes;
+
+            if ( e.pending )
+                --*e.pending;
+
+            idle_cond.notify_all();
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable work_cond; // signaled when there's new work
+    std::condition_variable idle_cond; // signaled when work has completed
+    std::deque<Entry> queue;
+    size_t queued_bytes = 0;
+    size_t max_queued_bytes;
+    bool busy = false;
+    bool done = false;
+    std::function<void(Item&)> process;
+
+    // Last, so that everything else is initialized once it starts running.
+    std::thread thread;
+};
+
+} // namespace zeek::file_analysis::detail
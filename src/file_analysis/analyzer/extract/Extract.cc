@@ -3,14 +3,177 @@
 #include "zeek/file_analysis/analyzer/extract/Extract.h"
 
 #include <fcntl.h>
+#include <atomic>
+#include <cinttypes>
+#include <memory>
+#include <mutex>
 #include <string>
 
 #include "zeek/file_analysis/Manager.h"
+#include "zeek/file_analysis/WorkerThread.h"
+#include "zeek/file_analysis/analyzer/extract/consts.bif.h"
 #include "zeek/file_analysis/analyzer/extract/events.bif.h"
 #include "zeek/util.h"
 
 namespace zeek::file_analysis::detail {
 
+// Content gets handed to the asynchronous writer in chunks of at least this size.
+constexpr size_t ASYNC_WRITE_CHUNK_SIZE = 65536;
+
+/**
+ * An extracted file written by the background writer. The writer owns it
+ * through the operations it has queued, so that the Extract analyzer can
+ * go away without waiting for them.
+ */
+struct AsyncExtractFile {
+    AsyncExtractFile(FILE* arg_f, std::string arg_filename) : f(arg_f), filename(std::move(arg_filename)) {}
+
+    FILE* f;
+    std::string filename;
+
+    // Set once an operation on the file failed. The writer skips all
+    // further operations on it but closing it.
+    std::atomic<bool> failed = false;
+};
+
+struct ExtractOp {
+    enum Kind : uint8_t { WRITE, SEEK, CLOSE } kind;
+    std::shared_ptr<AsyncExtractFile> file;
+    std::vector<u_char> data;
+    uint64_t pos;
+};
+
+/**
+ * A background thread doing the disk I/O of Extract analyzers when
+ * FileExtract::async_writes is set. Operations are carried out in the
+ * order they were queued, and none of them makes the main thread wait.
+ * As the thread can't use the reporter, it records errors for the main
+ * thread to report on a later pass.
+ */
+class ExtractWriter : public WorkerThread<ExtractOp> {
+public:
+    explicit ExtractWriter(size_t max_queued_bytes)
+        : WorkerThread("zk/extract", max_queued_bytes, [this](ExtractOp& op) { Run(op); }) {}
+
+    // The thread uses our members, so it must be done before they go away.
+    ~ExtractWriter() { Drain(); }
+
+    /**
+     * Queues content for writing at the file's current position. Never
+     * blocks: if the queue is full, the content is dropped instead.
+     *
+     * @return false if the content was dropped.
+     */
+    bool Write(std::shared_ptr<AsyncExtractFile> file, std::vector<u_char> data) {
+        auto n = data.size();
+        return TryPush({ExtractOp::WRITE, std::move(file), std::move(data), 0}, n);
+    }
+
+    /**
+     * Queues moving the file's position to the given offset.
+     */
+    void Seek(std::shared_ptr<AsyncExtractFile> file, uint64_t pos) {
+        Push({ExtractOp::SEEK, std::move(file), {}, pos}, 0);
+    }
+
+    /**
+     * Queues closing the file once everything queued before is done.
+     */
+    void Close(std::shared_ptr<AsyncExtractFile> file) { Push({ExtractOp::CLOSE, std::move(file), {}, 0}, 0); }
+
+    /**
+     * Reports any errors the writer encountered since the last call.
+     */
+    void ReportErrors() {
+        std::vector<std::string> to_report;
+
+        {
+            std::scoped_lock lock(errors_mtx);
+            to_report.swap(errors);
+        }
+
+        for ( const auto& e : to_report )
+            reporter->Error("%s", e.c_str());
+    }
+
+private:
+    using Op = ExtractOp;
+
+    void Run(const Op& op) {
+        // Once an operation on a file failed, we skip all but closing it.
+        if ( op.kind != Op::CLOSE && op.file->failed.load(std::memory_order_relaxed) )
+            return;
+
+        auto err = Perform(op);
+
+        if ( err.empty() )
+            return;
+
+        op.file->failed.store(true, std::memory_order_release);
+
+        std::scoped_lock lock(errors_mtx);
+        errors.push_back(std::move(err));
+    }
+
+    // Carries out the given operation, returning an error message if it failed.
+    std::string Perform(const Op& op) {
+        FILE* f = op.file->f;
+        const char* what = nullptr;
+
+        switch ( op.kind ) {
+            case Op::WRITE:
+                if ( ! op.data.empty() && fwrite(op.data.data(), op.data.size(), 1, f) != 1 )
+                    what = "failed to write to extracted file";
+                break;
+
+            case Op::SEEK:
+#ifdef _MSC_VER
+                if ( _fseeki64(f, op.pos, SEEK_SET) != 0 )
+#else
+                if ( fseek(f, op.pos, SEEK_SET) != 0 )
+#endif
+                    what = "failed to seek in extracted file";
+                break;
+
+            case Op::CLOSE:
+                op.file->f = nullptr;
+                if ( fclose(f) )
+                    what = "cannot close";
+                break;
+        }
+
+        if ( ! what )
+            return "";
+
+        char buf[128];
+        util::zeek_strerror_r(errno, buf, sizeof(buf));
+        return std::string(what) + " " + op.file->filename + ": " + buf;
+    }
+
+    std::mutex errors_mtx;
+    std::vector<std::string> errors;
+};
+
+static std::unique_ptr<ExtractWriter> extract_writer;
+
+static ExtractWriter* get_extract_writer() {
+    if ( ! extract_writer )
+        extract_writer = std::make_unique<ExtractWriter>(BifConst::FileExtract::async_max_queued_bytes);
+
+    return extract_writer.get();
+}
+
+void Extract::FinishAsyncWrites() {
+    if ( ! extract_writer )
+        return;
+
+    // Destroying the writer lets it finish all queued operations first.
+    std::unique_ptr<ExtractWriter> writer;
+    writer.swap(extract_writer);
+    writer->Drain();
+    writer->ReportErrors();
+}
+
 Extract::Extract(RecordValPtr args, file_analysis::File* file, std::string arg_filename, uint64_t arg_limit,
                  bool arg_limit_includes_missing)
     : file_analysis::Analyzer(file_mgr->GetComponentTag("EXTRACT"), std::move(args), file),
@@ -26,6 +189,11 @@ Extract::Extract(RecordValPtr args, file_analysis::File* file, std::string arg_f
             util::zeek_strerror_r(errno, buf, sizeof(buf));
             reporter->Warning("cannot set buffering mode for %s: %s", filename.data(), buf);
         }
+
+        if ( BifConst::FileExtract::async_writes ) {
+            async_file = std::make_shared<AsyncExtractFile>(file_stream, filename);
+            file_stream = nullptr;
+        }
     }
     else {
         util::zeek_strerror_r(errno, buf, sizeof(buf));
@@ -34,6 +202,13 @@ Extract::Extract(RecordValPtr args, file_analysis::File* file, std::string arg_f
 }
 
 Extract::~Extract() {
+    if ( async_file ) {
+        // The file may be going away as well, so don't raise weirds.
+        FlushBuffer(false);
+        CloseAsync();
+        return;
+    }
+
     if ( file_stream && fclose(file_stream) ) {
         char buf[128];
         util::zeek_strerror_r(errno, buf, sizeof(buf));
@@ -92,7 +267,7 @@ static bool check_limit_exceeded(uint64_t lim, uint64_t written, uint64_t len, u
 }
 
 bool Extract::DeliverStream(const u_char* data, uint64_t len) {
-    if ( ! file_stream )
+    if ( ! file_stream && ! async_file )
         return false;
 
     uint64_t towrite = 0;
@@ -108,6 +283,22 @@ bool Extract::DeliverStream(const u_char* data, uint64_t len) {
 
     char buf[128];
 
+    if ( async_file ) {
+        if ( ! CheckAsyncErrors() )
+            return false;
+
+        if ( towrite > 0 ) {
+            buffer.insert(buffer.end(), data, data + towrite);
+            written += towrite;
+        }
+
+        // As below, flush when we might not write for a while.
+        if ( limit_exceeded || buffer.size() >= ASYNC_WRITE_CHUNK_SIZE )
+            FlushBuffer();
+
+        return (! limit_exceeded);
+    }
+
     if ( towrite > 0 ) {
         if ( fwrite(data, towrite, 1, file_stream) != 1 ) {
             util::zeek_strerror_r(errno, buf, sizeof(buf));
@@ -133,7 +324,7 @@ bool Extract::DeliverStream(const u_char* data, uint64_t len) {
 }
 
 bool Extract::Undelivered(uint64_t offset, uint64_t len) {
-    if ( ! file_stream )
+    if ( ! file_stream && ! async_file )
         return false;
 
     if ( limit_includes_missing ) {
@@ -156,6 +347,16 @@ bool Extract::Undelivered(uint64_t offset, uint64_t len) {
         written += len;
     }
 
+    if ( async_file ) {
+        if ( ! CheckAsyncErrors() )
+            return false;
+
+        FlushBuffer();
+        stream_pos = len + offset;
+        get_extract_writer()->Seek(async_file, stream_pos);
+        return true;
+    }
+
 #ifdef _MSC_VER
     if ( _fseeki64(file_stream, len + offset, SEEK_SET) != 0 ) {
 #else
@@ -172,4 +373,45 @@ bool Extract::Undelivered(uint64_t offset, uint64_t len) {
     return true;
 }
 
+void Extract::FlushBuffer(bool report_drops) {
+    auto writer = get_extract_writer();
+    writer->ReportErrors();
+
+    if ( buffer.empty() )
+        return;
+
+    auto n = buffer.size();
+    std::vector<u_char> data;
+    data.reserve(ASYNC_WRITE_CHUNK_SIZE);
+    data.swap(buffer);
+
+    if ( ! writer->Write(async_file, std::move(data)) ) {
+        // Leave a hole where the content would have gone, as we do for
+        // content that's missing in the first place.
+        if ( report_drops )
+            Weird("file_extract_async_dropped", util::fmt("%zu bytes at offset %" PRIu64, n, stream_pos));
+        writer->Seek(async_file, stream_pos + n);
+    }
+
+    stream_pos += n;
+}
+
+bool Extract::CheckAsyncErrors() {
+    if ( ! async_file->failed.load(std::memory_order_acquire) )
+        return true;
+
+    // Give up on the file, as the synchronous path does on errors.
+    buffer.clear();
+    CloseAsync();
+    return false;
+}
+
+void Extract::CloseAsync() {
+    // The writer reports errors of the file's remaining operations,
+    // including the close's, on a later pass.
+    auto writer = get_extract_writer();
+    writer->Close(std::move(async_file));
+    writer->ReportErrors();
+}
+
 } // namespace zeek::file_analysis::detail
@@ -3,7 +3,9 @@
 #pragma once
 
 #include <cstdio>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "zeek/Val.h"
 #include "zeek/file_analysis/Analyzer.h"
@@ -11,6 +13,8 @@
 
 namespace zeek::file_analysis::detail {
 
+struct AsyncExtractFile;
+
 /**
  * An analyzer to extract content of files to local disk.
  */
@@ -54,6 +58,12 @@ public:
      */
     void SetLimit(uint64_t bytes) { limit = bytes; }
 
+    /**
+     * With asynchronous writes, waits for the background writer to finish
+     * all queued operations and reports their errors. Called at termination.
+     */
+    static void FinishAsyncWrites();
+
 protected:
     /**
      * Constructor.
@@ -68,11 +78,38 @@ protected:
             bool arg_limit_includes_missing);
 
 private:
+    /**
+     * With asynchronous writes, hands the content buffered so far to the
+     * background writer.
+     * @param report_drops whether to raise a weird if the writer's queue
+     *        is full and the content gets dropped.
+     */
+    void FlushBuffer(bool report_drops = true);
+
+    /**
+     * With asynchronous writes, checks whether the background writer
+     * failed on the file. If so, closes it.
+     * @return false if the writer failed on the file.
+     */
+    bool CheckAsyncErrors();
+
+    /**
+     * With asynchronous writes, hands the file to the background writer
+     * for closing, without waiting for that.
+     */
+    void CloseAsync();
+
     std::string filename;
     FILE* file_stream = nullptr;
     uint64_t limit = 0;                  // the file extraction limit
     uint64_t written = 0;                // how many bytes we have written so far
     bool limit_includes_missing = false; // do count missing bytes against limit if true
+
+    // State for FileExtract::async_writes. The file is then owned by
+    // async_file rather than file_stream.
+    std::shared_ptr<AsyncExtractFile> async_file;
+    std::vector<u_char> buffer; // content not yet handed to the writer
+    uint64_t stream_pos = 0;    // position of the file once the writer's done
 };
 
 } // namespace zeek::file_analysis::detail
@@ -17,6 +17,11 @@ public:
         config.description = "Extract file content";
         return config;
     }
+
+    void Done() override {
+        zeek::plugin::Plugin::Done();
+        zeek::file_analysis::detail::Extract::FinishAsyncWrites();
+    }
 } plugin;
 
 } // namespace zeek::plugin::detail::Zeek_FileExtract
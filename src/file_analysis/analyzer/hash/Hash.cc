@@ -2,12 +2,64 @@
 
 #include "zeek/file_analysis/analyzer/hash/Hash.h"
 
+#include <vector>
+
 #include "zeek/Event.h"
 #include "zeek/file_analysis/Manager.h"
+#include "zeek/file_analysis/WorkerThread.h"
+#include "zeek/file_analysis/analyzer/hash/consts.bif.h"
 #include "zeek/util.h"
 
 namespace zeek::file_analysis::detail {
 
+struct HashChunk {
+    Hash* h;
+    std::vector<u_char> data;
+};
+
+/**
+ * A background thread feeding file content into the hashes of the analyzers
+ * assigned to it. Content for any one analyzer is hashed in the order it was
+ * delivered.
+ */
+class HashWorker : public WorkerThread<HashChunk> {
+public:
+    explicit HashWorker(size_t max_queued_bytes)
+        : WorkerThread("zk/hash", max_queued_bytes,
+                       [](HashChunk& c) { c.h->hash->Feed(c.data.data(), c.data.size()); }) {}
+
+    /**
+     * Queues a copy of the given content for hashing by the analyzer's hash.
+     * Blocks if the thread has too much content queued already.
+     */
+    void Feed(Hash* h, const u_char* data, uint64_t len) {
+        Push({h, std::vector<u_char>(data, data + len)}, len, &h->pending);
+    }
+
+    /**
+     * Blocks until all content queued for the given analyzer is hashed.
+     */
+    void Wait(Hash* h) { WorkerThread::Wait(&h->pending); }
+};
+
+static std::vector<std::unique_ptr<HashWorker>> hash_workers;
+static size_t next_hash_worker = 0;
+
+// Returns the thread for a new hash analyzer, or nil if hashing happens
+// inline. Analyzers get assigned round-robin, so that the different
+// digests of a given file get computed concurrently.
+static HashWorker* assign_hash_worker() {
+    if ( BifConst::FileHash::worker_threads == 0 )
+        return nullptr;
+
+    if ( hash_workers.empty() ) {
+        for ( zeek_uint_t i = 0; i < BifConst::FileHash::worker_threads; ++i )
+            hash_workers.emplace_back(std::make_unique<HashWorker>(BifConst::FileHash::max_queued_bytes));
+    }
+
+    return hash_workers[next_hash_worker++ % hash_workers.size()].get();
+}
+
 StringValPtr MD5::kind_val = make_intrusive<StringVal>("md5");
 StringValPtr SHA1::kind_val = make_intrusive<StringVal>("sha1");
 StringValPtr SHA224::kind_val = make_intrusive<StringVal>("sha224");
@@ -19,11 +71,20 @@ Hash::Hash(RecordValPtr args, file_analysis::File* file, HashVal* hv, StringValP
     : file_analysis::Analyzer(file_mgr->GetComponentTag(util::to_upper(arg_kind->ToStdString())), std::move(args),
                               file),
       hash(hv),
-      kind(std::move(arg_kind)) {
+      kind(std::move(arg_kind)),
+      worker(assign_hash_worker()) {
     hash->Init();
 }
 
-Hash::~Hash() { Unref(hash); }
+Hash::~Hash() {
+    WaitForWorker();
+    Unref(hash);
+}
+
+void Hash::WaitForWorker() {
+    if ( worker )
+        worker->Wait(this);
+}
 
 bool Hash::DeliverStream(const u_char* data, uint64_t len) {
     if ( ! hash->IsValid() )
@@ -32,7 +93,11 @@ bool Hash::DeliverStream(const u_char* data, uint64_t len) {
     if ( ! fed )
         fed = len > 0;
 
-    hash->Feed(data, len);
+    if ( worker )
+        worker->Feed(this, data, len);
+    else
+        hash->Feed(data, len);
+
     return true;
 }
 
@@ -44,6 +109,8 @@ bool Hash::EndOfFile() {
 bool Hash::Undelivered(uint64_t offset, uint64_t len) { return false; }
 
 void Hash::Finalize() {
+    WaitForWorker();
+
     if ( ! hash->IsValid() || ! fed )
         return;
 
@@ -10,6 +10,8 @@
 
 namespace zeek::file_analysis::detail {
 
+class HashWorker;
+
 /**
  * An analyzer to produce a hash of file contents.
  */
@@ -60,9 +62,24 @@ protected:
     void Finalize();
 
 private:
+    friend class HashWorker;
+
+    /**
+     * Waits until a hashing thread, if any, has fed all content delivered
+     * so far into the hash.
+     */
+    void WaitForWorker();
+
     HashVal* hash = nullptr;
     bool fed = false;
     StringValPtr kind;
+
+    // Non-nil if content gets hashed by a background thread.
+    HashWorker* worker = nullptr;
+
+    // Number of chunks queued to the worker and not yet hashed. Only
+    // accessed under the worker's lock.
+    size_t pending = 0;
 };
 
 /**
@@ -4,10 +4,12 @@
 
 #include "zeek/file_analysis/Manager.h"
 
+#include "file_analysis/analyzer/pe/pe_pac.h"
+
 namespace zeek::file_analysis::detail {
 
 PE::PE(RecordValPtr args, file_analysis::File* file)
-    : file_analysis::Analyzer(file_mgr->GetComponentTag("PE"), std::move(args), file) {
+    : file_analysis::ThreadedAnalyzer(file_mgr->GetComponentTag("PE"), std::move(args), file) {
     conn = new binpac::PE::MockConnection(this);
     interp = new binpac::PE::File(conn);
     done = false;
@@ -18,20 +20,25 @@ PE::~PE() {
     delete conn;
 }
 
-bool PE::DeliverStream(const u_char* data, uint64_t len) {
+bool PE::ProcessStream(const u_char* data, uint64_t len) {
     if ( conn->is_done() )
         return false;
 
     try {
         interp->NewData(data, data + len);
     } catch ( const binpac::Exception& e ) {
-        AnalyzerViolation(util::fmt("Binpac exception: %s", e.what()));
+        RunOnMainThread([this, msg = std::string(e.what())] {
+            AnalyzerViolation(util::fmt("Binpac exception: %s", msg.c_str()));
+        });
         return false;
     }
 
     return ! conn->is_done();
 }
 
-bool PE::EndOfFile() { return false; }
+bool PE::EndOfFile() {
+    ThreadedAnalyzer::EndOfFile();
+    return false;
+}
 
 } // namespace zeek::file_analysis::detail
@@ -3,15 +3,22 @@
 #pragma once
 
 #include "zeek/Val.h"
+#include "zeek/file_analysis/ThreadedAnalyzer.h"
 
-#include "file_analysis/analyzer/pe/pe_pac.h"
+namespace binpac {
+namespace PE {
+class File;
+class MockConnection;
+} // namespace PE
+} // namespace binpac
 
 namespace zeek::file_analysis::detail {
 
 /**
- * Analyze Portable Executable files
+ * Analyze Portable Executable files. Parsing may happen on a file analysis
+ * worker thread, with events getting raised from the main thread.
  */
-class PE : public file_analysis::Analyzer {
+class PE : public file_analysis::ThreadedAnalyzer {
 public:
     ~PE() override;
 
@@ -19,11 +26,16 @@ public:
         return new PE(std::move(args), file);
     }
 
-    bool DeliverStream(const u_char* data, uint64_t len) override;
     bool EndOfFile() override;
 
+    // Used by the parser to raise events.
+    using ThreadedAnalyzer::RunOnMainThread;
+
 protected:
     PE(RecordValPtr args, file_analysis::File* file);
+
+    bool ProcessStream(const u_char* data, uint64_t len) override;
+
     binpac::PE::File* interp;
     binpac::PE::MockConnection* conn;
     bool done;
@@ -23,9 +23,12 @@ public:
         return config;
     }
 
+    void InitPostScript() override { zeek::file_analysis::detail::X509::InitParseCache(); }
+
     void Done() override {
         zeek::plugin::Plugin::Done();
         zeek::file_analysis::detail::X509::FreeRootStore();
+        zeek::file_analysis::detail::X509::ClearParseCache();
     }
 } plugin;
 
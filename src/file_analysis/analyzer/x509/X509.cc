@@ -11,18 +11,109 @@
 #include <openssl/opensslconf.h>
 #include <openssl/x509.h>
 #include <openssl/x509v3.h>
+#include <list>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 
 #include "zeek/Event.h"
 #include "zeek/broker/Data.h"
 #include "zeek/digest.h"
 #include "zeek/file_analysis/File.h"
 #include "zeek/file_analysis/Manager.h"
+#include "zeek/file_analysis/analyzer/x509/consts.bif.h"
 #include "zeek/file_analysis/analyzer/x509/events.bif.h"
 #include "zeek/file_analysis/analyzer/x509/types.bif.h"
+#include "zeek/telemetry/Manager.h"
+
+#include "zeek/3rdparty/doctest.h"
 
 namespace zeek::file_analysis::detail {
 
+namespace {
+
+/**
+ * A least-recently-used cache of parsed certificates, keyed by the SHA-256
+ * digest of their DER encoding.
+ */
+class ParsedCertificateCache {
+public:
+    struct Entry {
+        IntrusivePtr<X509Val> cert;
+        RecordValPtr record; // Only copies of this get handed out.
+    };
+
+    void SetMaxEntries(size_t n) {
+        max_entries = n;
+        Trim();
+    }
+
+    size_t MaxEntries() const { return max_entries; }
+    size_t Size() const { return index.size(); }
+
+    /**
+     * Returns the entry for a digest, or nil if there's none. The entry
+     * remains valid until the next modification of the cache.
+     */
+    const Entry* Lookup(std::string_view digest) {
+        auto it = index.find(digest);
+        if ( it == index.end() )
+            return nullptr;
+
+        lru.splice(lru.begin(), lru, it->second);
+        return &it->second->second;
+    }
+
+    void Insert(std::string digest, Entry entry) {
+        if ( max_entries == 0 || index.contains(digest) )
+            return;
+
+        lru.emplace_front(std::move(digest), std::move(entry));
+        index.emplace(lru.front().first, lru.begin());
+        Trim();
+    }
+
+    void Clear() {
+        index.clear();
+        lru.clear();
+    }
+
+private:
+    using List = std::list<std::pair<std::string, Entry>>;
+
+    void Trim() {
+        while ( index.size() > max_entries ) {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+
+    List lru; // Most recently used first.
+    std::unordered_map<std::string_view, List::iterator> index;
+    size_t max_entries = 0;
+};
+
+ParsedCertificateCache parse_cache;
+telemetry::CounterPtr parse_cache_hits;
+telemetry::CounterPtr parse_cache_misses;
+telemetry::GaugePtr parse_cache_entries;
+
+} // namespace
+
+void X509::InitParseCache() {
+    parse_cache.SetMaxEntries(BifConst::X509::parse_cache_max_entries);
+
+    parse_cache_hits = telemetry_mgr->CounterInstance("zeek", "x509_parse_cache_hits", {},
+                                                      "Number of certificates found in the parse cache");
+    parse_cache_misses = telemetry_mgr->CounterInstance("zeek", "x509_parse_cache_misses", {},
+                                                        "Number of certificates not found in the parse cache");
+    parse_cache_entries =
+        telemetry_mgr->GaugeInstance("zeek", "x509_parse_cache_entries", {}, "Number of certificates in the parse cache",
+                                     "", []() { return static_cast<double>(parse_cache.Size()); });
+}
+
+void X509::ClearParseCache() { parse_cache.Clear(); }
+
 X509::X509(RecordValPtr args, file_analysis::File* file)
     : X509Common::X509Common(file_mgr->GetComponentTag("X509"), std::move(args), file) {
     cert_data.clear();
@@ -38,12 +129,16 @@ bool X509::Undelivered(uint64_t offset, uint64_t len) { return false; }
 
 bool X509::EndOfFile() {
     const unsigned char* cert_char = reinterpret_cast<const unsigned char*>(cert_data.data());
-    if ( certificate_cache ) {
-        // first step - let's see if the certificate has been cached.
-        unsigned char buf[SHA256_DIGEST_LENGTH];
+    unsigned char buf[SHA256_DIGEST_LENGTH];
+
+    if ( certificate_cache || parse_cache.MaxEntries() > 0 ) {
         auto ctx = zeek::detail::hash_init(zeek::detail::Hash_SHA256);
         zeek::detail::hash_update(ctx, cert_char, cert_data.size());
         zeek::detail::hash_final(ctx, buf);
+    }
+
+    if ( certificate_cache ) {
+        // first step - let's see if the certificate has been cached.
         std::string cert_sha256 = zeek::detail::sha256_digest_print(buf);
         auto index = make_intrusive<StringVal>(cert_sha256);
         const auto& entry = certificate_cache->Find(index);
@@ -61,18 +156,48 @@ bool X509::EndOfFile() {
         }
     }
 
-    // ok, now we can try to parse the certificate with openssl. Should
-    // be rather straightforward...
-    ::X509* ssl_cert = d2i_X509(nullptr, &cert_char, cert_data.size());
-    if ( ! ssl_cert ) {
-        reporter->Weird(GetFile(), "x509_cert_parse_error");
-        return false;
+    ::X509* ssl_cert = nullptr;
+    X509Val* cert_val = nullptr;
+    RecordValPtr cert_record;
+    std::string digest;
+
+    if ( parse_cache.MaxEntries() > 0 ) {
+        digest.assign(reinterpret_cast<const char*>(buf), sizeof(buf));
+
+        if ( const auto* entry = parse_cache.Lookup(digest) ) {
+            // Each file gets its own opaque value and record, sharing
+            // the underlying certificate.
+            ssl_cert = entry->cert->GetCertificate();
+            X509_up_ref(ssl_cert);
+            cert_val = new X509Val(ssl_cert);
+            cert_record = cast_intrusive<RecordVal>(entry->record->Clone());
+            parse_cache_hits->Inc();
+        }
+        else
+            parse_cache_misses->Inc();
     }
 
-    X509Val* cert_val = new X509Val(ssl_cert); // cert_val takes ownership of ssl_cert
+    if ( ! cert_val ) {
+        // ok, now we can try to parse the certificate with openssl. Should
+        // be rather straightforward...
+        ssl_cert = d2i_X509(nullptr, &cert_char, cert_data.size());
+        if ( ! ssl_cert ) {
+            reporter->Weird(GetFile(), "x509_cert_parse_error");
+            return false;
+        }
+
+        cert_val = new X509Val(ssl_cert); // cert_val takes ownership of ssl_cert
 
-    // parse basic information into record.
-    auto cert_record = ParseCertificate(cert_val, GetFile());
+        // parse basic information into record.
+        auto weirds = reporter->GetWeirdCount();
+        cert_record = ParseCertificate(cert_val, GetFile());
+
+        // Certificates raising weirds while getting parsed don't go into
+        // the cache, so that the weirds get raised for every file.
+        if ( ! digest.empty() && reporter->GetWeirdCount() == weirds )
+            parse_cache.Insert(std::move(digest), {IntrusivePtr{NewRef{}, cert_val},
+                                                   cast_intrusive<RecordVal>(cert_record->Clone())});
+    }
 
     // and send the record on to scriptland
     if ( x509_certificate )
@@ -484,3 +609,34 @@ bool X509Val::DoUnserializeData(BrokerDataView data) {
 }
 
 } // namespace zeek::file_analysis::detail
+
+TEST_SUITE_BEGIN("x509 parse cache");
+
+TEST_CASE("lru eviction") {
+    zeek::file_analysis::detail::ParsedCertificateCache c;
+
+    c.Insert("a", {});
+    CHECK(c.Size() == 0);
+
+    c.SetMaxEntries(2);
+    c.Insert("a", {});
+    c.Insert("b", {});
+    CHECK(c.Size() == 2);
+
+    // Using "a" makes "b" the next one to go.
+    CHECK(c.Lookup("a"));
+    c.Insert("c", {});
+    CHECK(c.Size() == 2);
+    CHECK(c.Lookup("a"));
+    CHECK_FALSE(c.Lookup("b"));
+    CHECK(c.Lookup("c"));
+
+    c.SetMaxEntries(1);
+    CHECK(c.Size() == 1);
+    CHECK(c.Lookup("c"));
+
+    c.Clear();
+    CHECK_FALSE(c.Lookup("c"));
+}
+
+TEST_SUITE_END();
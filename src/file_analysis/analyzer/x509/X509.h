@@ -70,6 +70,18 @@ public:
      */
     static void SetCertificateCacheHitCallback(FuncPtr func) { cache_hit_callback = std::move(func); }
 
+    /**
+     * Sizes the cache of parsed certificates according to
+     * X509::parse_cache_max_entries and registers its metrics. Called once
+     * scripts have been parsed.
+     */
+    static void InitParseCache();
+
+    /**
+     * Empties the cache of parsed certificates.
+     */
+    static void ClearParseCache();
+
 protected:
     X509(RecordValPtr args, file_analysis::File* file);
 
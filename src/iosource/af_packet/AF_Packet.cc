@@ -5,6 +5,7 @@
 #include <system_error>
 
 #include "zeek/Reporter.h"
+#include "zeek/iosource/af_packet/FanoutProgram.h"
 #include "zeek/iosource/af_packet/RX_Ring.h"
 #include "zeek/iosource/af_packet/af_packet.bif.h"
 
@@ -180,10 +181,35 @@ bool AF_PacketSource::ConfigureFanoutGroup(bool enabled, bool defrag) {
 
         if ( setsockopt(socket_fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) < 0 )
             return false;
+
+        if ( zeek::BifConst::AF_Packet::fanout_mode->AsEnum() == BifEnum::AF_Packet::FANOUT_INNER_HASH )
+            return AttachInnerHashProgram();
     }
     return true;
 }
 
+bool AF_PacketSource::AttachInnerHashProgram() {
+#if defined(PACKET_FANOUT_CBPF) && defined(PACKET_FANOUT_DATA)
+    // All members of the group install the same program, so it doesn't
+    // matter which one's ends up being used.
+    auto prog = BuildInnerHashFanoutProgram();
+
+    if ( prog.empty() ) {
+        errno = EINVAL;
+        return false;
+    }
+
+    struct sock_fprog fprog;
+    fprog.len = prog.size();
+    fprog.filter = prog.data();
+
+    return setsockopt(socket_fd, SOL_PACKET, PACKET_FANOUT_DATA, &fprog, sizeof(fprog)) >= 0;
+#else
+    errno = ENOTSUP;
+    return false;
+#endif
+}
+
 bool AF_PacketSource::ConfigureHWTimestamping(bool enabled) {
     if ( enabled ) {
         struct ifreq ifr;
@@ -215,7 +241,8 @@ uint32_t AF_PacketSource::GetFanoutMode(bool defrag) {
         case BifEnum::AF_Packet::FANOUT_QM: fanout_mode = PACKET_FANOUT_QM; break;
 #endif
 #ifdef PACKET_FANOUT_CBPF
-        case BifEnum::AF_Packet::FANOUT_CBPF: fanout_mode = PACKET_FANOUT_CBPF; break;
+        case BifEnum::AF_Packet::FANOUT_CBPF:
+        case BifEnum::AF_Packet::FANOUT_INNER_HASH: fanout_mode = PACKET_FANOUT_CBPF; break;
 #endif
 #ifdef PACKET_FANOUT_EBPF
         case BifEnum::AF_Packet::FANOUT_EBPF: fanout_mode = PACKET_FANOUT_EBPF; break;
@@ -75,6 +75,7 @@ private:
     bool BindInterface(const InterfaceInfo& info);
     bool EnablePromiscMode(const InterfaceInfo& info);
     bool ConfigureFanoutGroup(bool enabled, bool defrag);
+    bool AttachInnerHashProgram();
     bool ConfigureHWTimestamping(bool enabled);
     uint32_t GetFanoutMode(bool defrag);
 };
@@ -0,0 +1,814 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/iosource/af_packet/FanoutProgram.h"
+
+#include <netinet/in.h>
+#include <initializer_list>
+#include <utility>
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::iosource::af_packet {
+
+namespace {
+
+constexpr uint32_t PORT_VXLAN = 4789;
+constexpr uint32_t PORT_GENEVE = 6081;
+constexpr uint32_t PORT_GTPV1_U = 2152;
+
+constexpr uint32_t ETHERTYPE_IPV4 = 0x0800;
+constexpr uint32_t ETHERTYPE_IPV6 = 0x86dd;
+constexpr uint32_t ETHERTYPE_TEB = 0x6558;
+
+constexpr uint32_t IP4_FRAGMENT_MASK = 0x3fff;
+constexpr uint32_t GRE_FLAG_CSUM = 0x8000;
+constexpr uint32_t GRE_FLAG_KEY = 0x2000;
+constexpr uint32_t GRE_FLAG_SEQ = 0x1000;
+constexpr uint32_t GRE_UNSUPPORTED = 0x4007; // Routing present or version != 0.
+constexpr uint32_t GTP_V1_GPDU_FLAGS = 0x30; // Version 1, protocol type GTP.
+constexpr uint32_t GTP_MSG_GPDU = 0xff;
+constexpr uint32_t GTP_FLAG_EXT = 0x04;
+constexpr uint32_t GTP_FLAG_OPTIONAL = 0x07;
+constexpr int GTP_MAX_EXT_HEADERS = 2;
+
+constexpr uint32_t HASH_PORT_MULT = 0x9e3779b1;
+constexpr uint32_t HASH_MIX_MULT1 = 0x85ebca6b;
+constexpr uint32_t HASH_MIX_MULT2 = 0xc2b2ae35;
+
+bool HasPorts(uint32_t proto) { return proto == IPPROTO_TCP || proto == IPPROTO_UDP || proto == IPPROTO_SCTP; }
+
+// The components are combined with commutative operations before mixing,
+// which makes the hash identical for both directions of a flow.
+uint32_t Mix(uint32_t addrs, uint32_t ports, uint32_t proto) {
+    uint32_t h = (ports * HASH_PORT_MULT) ^ addrs ^ proto;
+    h ^= h >> 16;
+    h *= HASH_MIX_MULT1;
+    h ^= h >> 13;
+    h *= HASH_MIX_MULT2;
+    h ^= h >> 16;
+    return h;
+}
+
+// Scratch memory slots used by the program.
+enum Slot : uint32_t {
+    SLOT_ADDRS = 0,
+    SLOT_PROTO = 1,
+    SLOT_PORTS = 2,
+    SLOT_OFFSET = 3,
+    SLOT_BASE = 4,
+};
+
+// A minimal assembler for classic BPF that resolves forward jumps to labels.
+class Assembler {
+public:
+    using Label = size_t;
+    static constexpr Label NEXT = SIZE_MAX;
+
+    Label NewLabel() {
+        labels.push_back(UNBOUND);
+        return labels.size() - 1;
+    }
+
+    void Bind(Label l) { labels[l] = insns.size(); }
+
+    // Loads relative to the network header, optionally indexed by X.
+    void LoadB(int32_t offset, bool indexed = true) { Load(BPF_B, offset, indexed); }
+    void LoadH(int32_t offset, bool indexed = true) { Load(BPF_H, offset, indexed); }
+    void LoadW(int32_t offset, bool indexed = true) { Load(BPF_W, offset, indexed); }
+
+    void LoadImm(uint32_t k) { Stmt(BPF_LD | BPF_IMM, k); }
+    void LoadMem(Slot s) { Stmt(BPF_LD | BPF_MEM, s); }
+    void LoadXImm(uint32_t k) { Stmt(BPF_LDX | BPF_IMM, k); }
+    void LoadXMem(Slot s) { Stmt(BPF_LDX | BPF_MEM, s); }
+    void Store(Slot s) { Stmt(BPF_ST, s); }
+    void Alu(uint16_t op, uint32_t k) { Stmt(BPF_ALU | op | BPF_K, k); }
+    void AluX(uint16_t op) { Stmt(BPF_ALU | op | BPF_X, 0); }
+    void Tax() { Stmt(BPF_MISC | BPF_TAX, 0); }
+    void Txa() { Stmt(BPF_MISC | BPF_TXA, 0); }
+    void RetA() { Stmt(BPF_RET | BPF_A, 0); }
+    void RetK(uint32_t k) { Stmt(BPF_RET | BPF_K, k); }
+
+    // Adds k to X, clobbering A.
+    void AddX(uint32_t k) {
+        Txa();
+        Alu(BPF_ADD, k);
+        Tax();
+    }
+
+    void JumpIf(uint16_t op, uint32_t k, Label jt, Label jf) {
+        fixups.push_back({insns.size(), jt, jf, false});
+        insns.push_back(BPF_JUMP(BPF_JMP | op | BPF_K, k, 0, 0));
+    }
+
+    void Goto(Label l) {
+        fixups.push_back({insns.size(), l, NEXT, true});
+        insns.push_back(BPF_JUMP(BPF_JMP | BPF_JA, 0, 0, 0));
+    }
+
+    std::vector<sock_filter> Finish() {
+        for ( const auto& f : fixups ) {
+            size_t jt, jf;
+
+            if ( ! Resolve(f.index, f.jt, &jt) || ! Resolve(f.index, f.jf, &jf) )
+                return {};
+
+            if ( f.unconditional ) {
+                insns[f.index].k = jt;
+                continue;
+            }
+
+            if ( jt > UINT8_MAX || jf > UINT8_MAX )
+                return {};
+
+            insns[f.index].jt = jt;
+            insns[f.index].jf = jf;
+        }
+
+        if ( insns.empty() || insns.size() > BPF_MAXINSNS )
+            return {};
+
+        return std::move(insns);
+    }
+
+private:
+    static constexpr size_t UNBOUND = SIZE_MAX;
+
+    struct Fixup {
+        size_t index;
+        Label jt;
+        Label jf;
+        bool unconditional;
+    };
+
+    void Stmt(uint16_t code, uint32_t k) { insns.push_back(BPF_STMT(code, k)); }
+
+    void Load(uint16_t size, int32_t offset, bool indexed) {
+        Stmt(BPF_LD | size | (indexed ? BPF_IND : BPF_ABS), static_cast<uint32_t>(SKF_NET_OFF + offset));
+    }
+
+    // Only forward jumps are valid in classic BPF.
+    bool Resolve(size_t index, Label l, size_t* offset) const {
+        if ( l == NEXT ) {
+            *offset = 0;
+            return true;
+        }
+
+        size_t target = labels[l];
+
+        if ( target == UNBOUND || target <= index )
+            return false;
+
+        *offset = target - index - 1;
+        return true;
+    }
+
+    std::vector<sock_filter> insns;
+    std::vector<size_t> labels;
+    std::vector<Fixup> fixups;
+};
+
+// Bounds-checked big-endian reads mirroring the program's loads. A failed
+// read makes the kernel abort the program with a return value of 0; the
+// failure is sticky here so that InnerFlowHash() can do the same.
+class Reader {
+public:
+    Reader(const u_char* data, size_t len) : data(data), len(len) {}
+
+    uint32_t B(size_t offset) { return Read(offset, 1); }
+    uint32_t H(size_t offset) { return Read(offset, 2); }
+    uint32_t W(size_t offset) { return Read(offset, 4); }
+
+    bool Ok() const { return ok; }
+
+private:
+    uint32_t Read(size_t offset, size_t n) {
+        if ( offset > len || len - offset < n ) {
+            ok = false;
+            return 0;
+        }
+
+        uint32_t v = 0;
+        for ( size_t i = 0; i < n; ++i )
+            v = (v << 8) | data[offset + i];
+
+        return v;
+    }
+
+    const u_char* data;
+    size_t len;
+    bool ok = true;
+};
+
+// The helpers below return the offset of the inner IP header, or 0 to
+// fall back to the outer one.
+
+uint32_t InnerIP(Reader& r, uint32_t x) {
+    uint32_t version = r.B(x) >> 4;
+    return (version == 4 || version == 6) ? x : 0;
+}
+
+uint32_t InnerEthernet(Reader& r, uint32_t x) {
+    uint32_t ethertype = r.H(x + 12);
+    return (ethertype == ETHERTYPE_IPV4 || ethertype == ETHERTYPE_IPV6) ? InnerIP(r, x + 14) : 0;
+}
+
+uint32_t InnerByEthertype(Reader& r, uint32_t ethertype, uint32_t x) {
+    if ( ethertype == ETHERTYPE_IPV4 || ethertype == ETHERTYPE_IPV6 )
+        return InnerIP(r, x);
+
+    if ( ethertype == ETHERTYPE_TEB )
+        return InnerEthernet(r, x);
+
+    return 0;
+}
+
+uint32_t InnerGTP(Reader& r, uint32_t x) {
+    if ( (r.B(x + 8) & 0xf0) != GTP_V1_GPDU_FLAGS || r.B(x + 9) != GTP_MSG_GPDU )
+        return 0;
+
+    if ( ! (r.B(x + 8) & GTP_FLAG_OPTIONAL) )
+        return InnerIP(r, x + 16);
+
+    if ( ! (r.B(x + 8) & GTP_FLAG_EXT) )
+        return InnerIP(r, x + 20);
+
+    // Each extension header's last byte is the type of the next one.
+    x += 20;
+    if ( r.B(x - 1) == 0 )
+        return InnerIP(r, x);
+
+    for ( int i = 0; i < GTP_MAX_EXT_HEADERS; ++i ) {
+        x += r.B(x) << 2;
+        if ( r.B(x - 1) == 0 )
+            return InnerIP(r, x);
+    }
+
+    return 0;
+}
+
+uint32_t InnerGRE(Reader& r, uint32_t x) {
+    uint32_t flags = r.H(x);
+
+    if ( flags & GRE_UNSUPPORTED )
+        return 0;
+
+    uint32_t payload = x + 4;
+    if ( r.H(x) & GRE_FLAG_CSUM )
+        payload += 4;
+    if ( r.H(x) & GRE_FLAG_KEY )
+        payload += 4;
+    if ( r.H(x) & GRE_FLAG_SEQ )
+        payload += 4;
+
+    return InnerByEthertype(r, r.H(x + 2), payload);
+}
+
+uint32_t InnerGeneve(Reader& r, uint32_t x) {
+    uint32_t payload = ((r.B(x + 8) & 0x3f) << 2) + 16 + x;
+    return InnerByEthertype(r, r.H(x + 10), payload);
+}
+
+uint32_t FindInner(Reader& r) {
+    uint32_t x;
+    uint32_t proto;
+
+    switch ( r.B(0) >> 4 ) {
+        case 4:
+            if ( r.H(6) & IP4_FRAGMENT_MASK )
+                return 0;
+
+            x = (r.B(0) & 0x0f) << 2;
+            proto = r.B(9);
+            break;
+
+        case 6:
+            x = 40;
+            proto = r.B(6);
+            break;
+
+        default: return 0;
+    }
+
+    if ( proto == IPPROTO_GRE )
+        return InnerGRE(r, x);
+
+    if ( proto != IPPROTO_UDP )
+        return 0;
+
+    switch ( r.H(x + 2) ) {
+        case PORT_VXLAN: return InnerEthernet(r, x + 16);
+        case PORT_GENEVE: return InnerGeneve(r, x);
+        case PORT_GTPV1_U: return InnerGTP(r, x);
+        default: return 0;
+    }
+}
+
+uint32_t HashIP(Reader& r, uint32_t x) {
+    uint32_t addrs = 0;
+    uint32_t proto;
+    uint32_t l4;
+
+    switch ( r.B(x) >> 4 ) {
+        case 4:
+            addrs = r.W(x + 12) + r.W(x + 16);
+            proto = r.B(x + 9);
+
+            if ( r.H(x + 6) & IP4_FRAGMENT_MASK )
+                return Mix(addrs, 0, proto);
+
+            l4 = x + ((r.B(x) & 0x0f) << 2);
+            break;
+
+        case 6:
+            for ( uint32_t i = 0; i < 8; ++i )
+                addrs += r.W(x + 8 + 4 * i);
+
+            proto = r.B(x + 6);
+            l4 = x + 40;
+            break;
+
+        default: return 0;
+    }
+
+    uint32_t ports = HasPorts(proto) ? r.H(l4) + r.H(l4 + 2) : 0;
+    return Mix(addrs, ports, proto);
+}
+
+// Emits the jumps for "A is IPv4 or IPv6 ethertype".
+void JumpIfIPEthertype(Assembler& a, Assembler::Label jt, Assembler::Label jf) {
+    auto next = a.NewLabel();
+    a.JumpIf(BPF_JEQ, ETHERTYPE_IPV4, jt, next);
+    a.Bind(next);
+    a.JumpIf(BPF_JEQ, ETHERTYPE_IPV6, jt, jf);
+}
+
+} // namespace
+
+std::vector<sock_filter> BuildInnerHashFanoutProgram() {
+    Assembler a;
+
+    auto outer4 = a.NewLabel();
+    auto outer6 = a.NewLabel();
+    auto udp = a.NewLabel();
+    auto vxlan = a.NewLabel();
+    auto geneve = a.NewLabel();
+    auto gtp = a.NewLabel();
+    auto gtp_optional = a.NewLabel();
+    auto gtp_ext = a.NewLabel();
+    auto gre = a.NewLabel();
+    auto by_ethertype = a.NewLabel();
+    auto ethernet = a.NewLabel();
+    auto ethernet_ip = a.NewLabel();
+    auto inner = a.NewLabel();
+    auto plain = a.NewLabel();
+    auto hash = a.NewLabel();
+    auto hash4 = a.NewLabel();
+    auto hash6 = a.NewLabel();
+    auto ports = a.NewLabel();
+    auto mix = a.NewLabel();
+
+    // Outer IP header; leaves X at the transport header.
+    a.LoadB(0, false);
+    a.Alu(BPF_RSH, 4);
+    a.JumpIf(BPF_JEQ, 4, outer4, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, 6, outer6, plain);
+
+    a.Bind(outer4);
+    a.LoadH(6, false);
+    a.JumpIf(BPF_JSET, IP4_FRAGMENT_MASK, plain, Assembler::NEXT);
+    a.LoadB(0, false);
+    a.Alu(BPF_AND, 0x0f);
+    a.Alu(BPF_LSH, 2);
+    a.Tax();
+    a.LoadB(9, false);
+    a.JumpIf(BPF_JEQ, IPPROTO_UDP, udp, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, IPPROTO_GRE, gre, plain);
+
+    a.Bind(outer6);
+    a.LoadXImm(40);
+    a.LoadB(6, false);
+    a.JumpIf(BPF_JEQ, IPPROTO_UDP, udp, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, IPPROTO_GRE, gre, plain);
+
+    a.Bind(udp);
+    a.LoadH(2);
+    a.JumpIf(BPF_JEQ, PORT_VXLAN, vxlan, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, PORT_GENEVE, geneve, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, PORT_GTPV1_U, gtp, plain);
+
+    // UDP and VXLAN headers, followed by Ethernet.
+    a.Bind(vxlan);
+    a.AddX(16);
+    a.Goto(ethernet);
+
+    a.Bind(gtp);
+    a.LoadB(8);
+    a.Alu(BPF_AND, 0xf0);
+    a.JumpIf(BPF_JEQ, GTP_V1_GPDU_FLAGS, Assembler::NEXT, plain);
+    a.LoadB(9);
+    a.JumpIf(BPF_JEQ, GTP_MSG_GPDU, Assembler::NEXT, plain);
+    a.LoadB(8);
+    a.JumpIf(BPF_JSET, GTP_FLAG_OPTIONAL, gtp_optional, Assembler::NEXT);
+    a.AddX(16);
+    a.Goto(inner);
+
+    a.Bind(gtp_optional);
+    a.LoadB(8);
+    a.JumpIf(BPF_JSET, GTP_FLAG_EXT, gtp_ext, Assembler::NEXT);
+    a.AddX(20);
+    a.Goto(inner);
+
+    // Extension headers are unrolled since classic BPF can't loop. Each
+    // one's last byte is the type of the next.
+    a.Bind(gtp_ext);
+    a.AddX(20);
+    a.LoadB(-1);
+    a.JumpIf(BPF_JEQ, 0, inner, Assembler::NEXT);
+
+    for ( int i = 0; i < GTP_MAX_EXT_HEADERS; ++i ) {
+        a.LoadB(0);
+        a.Alu(BPF_LSH, 2);
+        a.AluX(BPF_ADD);
+        a.Tax();
+        a.LoadB(-1);
+        a.JumpIf(BPF_JEQ, 0, inner, i + 1 < GTP_MAX_EXT_HEADERS ? Assembler::NEXT : plain);
+    }
+
+    // GRE header length depends on the optional fields present.
+    auto gre_key = a.NewLabel();
+    auto gre_seq = a.NewLabel();
+    auto gre_proto = a.NewLabel();
+
+    a.Bind(gre);
+    a.LoadH(0);
+    a.JumpIf(BPF_JSET, GRE_UNSUPPORTED, plain, Assembler::NEXT);
+    a.Txa();
+    a.Alu(BPF_ADD, 4);
+    a.Store(SLOT_OFFSET);
+
+    for ( auto [flag, skip] : {std::pair{GRE_FLAG_CSUM, gre_key}, std::pair{GRE_FLAG_KEY, gre_seq},
+                               std::pair{GRE_FLAG_SEQ, gre_proto}} ) {
+        a.LoadH(0);
+        a.JumpIf(BPF_JSET, flag, Assembler::NEXT, skip);
+        a.LoadMem(SLOT_OFFSET);
+        a.Alu(BPF_ADD, 4);
+        a.Store(SLOT_OFFSET);
+        a.Bind(skip);
+    }
+
+    a.LoadH(2);
+    a.Goto(by_ethertype);
+
+    // Geneve header plus its variable-length options.
+    a.Bind(geneve);
+    a.LoadB(8);
+    a.Alu(BPF_AND, 0x3f);
+    a.Alu(BPF_LSH, 2);
+    a.Alu(BPF_ADD, 16);
+    a.AluX(BPF_ADD);
+    a.Store(SLOT_OFFSET);
+    a.LoadH(10);
+
+    // Expects the payload's ethertype in A and its offset in SLOT_OFFSET.
+    a.Bind(by_ethertype);
+    a.LoadXMem(SLOT_OFFSET);
+    JumpIfIPEthertype(a, inner, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, ETHERTYPE_TEB, ethernet, plain);
+
+    // Inner Ethernet header at X.
+    a.Bind(ethernet);
+    a.LoadH(12);
+    JumpIfIPEthertype(a, ethernet_ip, plain);
+
+    a.Bind(ethernet_ip);
+    a.AddX(14);
+
+    // Inner IP header at X, falling back to the outer header if it's
+    // something else.
+    a.Bind(inner);
+    a.LoadB(0);
+    a.Alu(BPF_RSH, 4);
+    a.JumpIf(BPF_JEQ, 4, hash, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, 6, hash, Assembler::NEXT);
+
+    a.Bind(plain);
+    a.LoadXImm(0);
+
+    // Hash the IP header at X.
+    a.Bind(hash);
+    a.LoadB(0);
+    a.Alu(BPF_RSH, 4);
+    a.JumpIf(BPF_JEQ, 4, hash4, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, 6, hash6, Assembler::NEXT);
+    a.RetK(0);
+
+    a.Bind(hash4);
+    a.Txa();
+    a.Store(SLOT_BASE);
+    a.LoadW(12);
+    a.Store(SLOT_ADDRS);
+    a.LoadW(16);
+    a.LoadXMem(SLOT_ADDRS);
+    a.AluX(BPF_ADD);
+    a.Store(SLOT_ADDRS);
+    a.LoadXMem(SLOT_BASE);
+    a.LoadB(9);
+    a.Store(SLOT_PROTO);
+    a.LoadImm(0);
+    a.Store(SLOT_PORTS);
+    a.LoadH(6);
+    a.JumpIf(BPF_JSET, IP4_FRAGMENT_MASK, mix, Assembler::NEXT);
+    a.LoadB(0);
+    a.Alu(BPF_AND, 0x0f);
+    a.Alu(BPF_LSH, 2);
+    a.AluX(BPF_ADD);
+    a.Tax();
+    a.LoadMem(SLOT_PROTO);
+    a.JumpIf(BPF_JEQ, IPPROTO_TCP, ports, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, IPPROTO_UDP, ports, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, IPPROTO_SCTP, ports, mix);
+
+    a.Bind(hash6);
+    a.Txa();
+    a.Store(SLOT_BASE);
+    a.LoadW(8);
+    a.Store(SLOT_ADDRS);
+
+    for ( int32_t offset = 12; offset < 40; offset += 4 ) {
+        a.LoadW(offset);
+        a.LoadXMem(SLOT_ADDRS);
+        a.AluX(BPF_ADD);
+        a.Store(SLOT_ADDRS);
+        a.LoadXMem(SLOT_BASE);
+    }
+
+    a.LoadB(6);
+    a.Store(SLOT_PROTO);
+    a.LoadImm(0);
+    a.Store(SLOT_PORTS);
+    a.AddX(40);
+    a.LoadMem(SLOT_PROTO);
+    a.JumpIf(BPF_JEQ, IPPROTO_TCP, ports, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, IPPROTO_UDP, ports, Assembler::NEXT);
+    a.JumpIf(BPF_JEQ, IPPROTO_SCTP, ports, mix);
+
+    // Transport header at X.
+    a.Bind(ports);
+    a.LoadH(0);
+    a.Store(SLOT_PORTS);
+    a.LoadH(2);
+    a.LoadXMem(SLOT_PORTS);
+    a.AluX(BPF_ADD);
+    a.Store(SLOT_PORTS);
+
+    // Same as Mix().
+    a.Bind(mix);
+    a.LoadMem(SLOT_PORTS);
+    a.Alu(BPF_MUL, HASH_PORT_MULT);
+    a.LoadXMem(SLOT_ADDRS);
+    a.AluX(BPF_XOR);
+    a.LoadXMem(SLOT_PROTO);
+    a.AluX(BPF_XOR);
+
+    for ( auto [shift, mult] : {std::pair{16u, HASH_MIX_MULT1}, std::pair{13u, HASH_MIX_MULT2}, std::pair{16u, 0u}} ) {
+        a.Tax();
+        a.Alu(BPF_RSH, shift);
+        a.AluX(BPF_XOR);
+
+        if ( mult )
+            a.Alu(BPF_MUL, mult);
+    }
+
+    a.RetA();
+
+    return a.Finish();
+}
+
+uint32_t InnerFlowHash(const u_char* data, size_t len) {
+    Reader r(data, len);
+    uint32_t h = HashIP(r, FindInner(r));
+    return r.Ok() ? h : 0;
+}
+
+} // namespace zeek::iosource::af_packet
+
+TEST_SUITE_BEGIN("af_packet inner hash fanout");
+
+namespace {
+
+using zeek::iosource::af_packet::BuildInnerHashFanoutProgram;
+using zeek::iosource::af_packet::InnerFlowHash;
+
+using Bytes = std::vector<u_char>;
+
+// Interprets the subset of classic BPF the fanout program uses, with loads
+// relative to the network header like the kernel's SKF_NET_OFF.
+uint32_t RunProgram(const std::vector<sock_filter>& prog, const Bytes& pkt) {
+    uint32_t A = 0;
+    uint32_t X = 0;
+    uint32_t M[BPF_MEMWORDS] = {};
+
+    for ( size_t pc = 0; pc < prog.size(); ++pc ) {
+        const auto& insn = prog[pc];
+        uint16_t cls = BPF_CLASS(insn.code);
+
+        if ( cls == BPF_LD && (BPF_MODE(insn.code) == BPF_ABS || BPF_MODE(insn.code) == BPF_IND) ) {
+            int64_t offset = static_cast<int32_t>(insn.k) - SKF_NET_OFF;
+            if ( BPF_MODE(insn.code) == BPF_IND )
+                offset += X;
+
+            size_t n = BPF_SIZE(insn.code) == BPF_B ? 1 : BPF_SIZE(insn.code) == BPF_H ? 2 : 4;
+            if ( offset < 0 || static_cast<size_t>(offset) + n > pkt.size() )
+                return 0;
+
+            A = 0;
+            for ( size_t i = 0; i < n; ++i )
+                A = (A << 8) | pkt[offset + i];
+        }
+        else if ( insn.code == (BPF_LD | BPF_IMM) )
+            A = insn.k;
+        else if ( insn.code == (BPF_LD | BPF_MEM) )
+            A = M[insn.k];
+        else if ( insn.code == (BPF_LDX | BPF_IMM) )
+            X = insn.k;
+        else if ( insn.code == (BPF_LDX | BPF_MEM) )
+            X = M[insn.k];
+        else if ( insn.code == BPF_ST )
+            M[insn.k] = A;
+        else if ( cls == BPF_ALU ) {
+            uint32_t v = BPF_SRC(insn.code) == BPF_X ? X : insn.k;
+            switch ( BPF_OP(insn.code) ) {
+                case BPF_ADD: A += v; break;
+                case BPF_MUL: A *= v; break;
+                case BPF_AND: A &= v; break;
+                case BPF_XOR: A ^= v; break;
+                case BPF_LSH: A <<= v; break;
+                case BPF_RSH: A >>= v; break;
+                default: FAIL("unexpected ALU operation"); return 0;
+            }
+        }
+        else if ( insn.code == (BPF_JMP | BPF_JA) )
+            pc += insn.k;
+        else if ( insn.code == (BPF_JMP | BPF_JEQ | BPF_K) )
+            pc += (A == insn.k) ? insn.jt : insn.jf;
+        else if ( insn.code == (BPF_JMP | BPF_JSET | BPF_K) )
+            pc += (A & insn.k) ? insn.jt : insn.jf;
+        else if ( insn.code == (BPF_MISC | BPF_TAX) )
+            X = A;
+        else if ( insn.code == (BPF_MISC | BPF_TXA) )
+            A = X;
+        else if ( insn.code == (BPF_RET | BPF_A) )
+            return A;
+        else if ( insn.code == (BPF_RET | BPF_K) )
+            return insn.k;
+        else {
+            FAIL("unexpected instruction");
+            return 0;
+        }
+    }
+
+    FAIL("program ran off its end");
+    return 0;
+}
+
+Bytes Concat(std::initializer_list<Bytes> parts) {
+    Bytes result;
+    for ( const auto& p : parts )
+        result.insert(result.end(), p.begin(), p.end());
+    return result;
+}
+
+Bytes Be16(uint16_t v) { return {static_cast<u_char>(v >> 8), static_cast<u_char>(v)}; }
+
+Bytes IPv4(Bytes src, Bytes dst, u_char proto, const Bytes& payload, uint16_t frag = 0) {
+    auto total = Be16(20 + payload.size());
+    auto f = Be16(frag);
+    Bytes hdr = {0x45, 0, total[0], total[1], 0, 0, f[0], f[1], 64, proto, 0, 0};
+    return Concat({hdr, src, dst, payload});
+}
+
+Bytes IPv6(Bytes src, Bytes dst, u_char proto, const Bytes& payload) {
+    auto plen = Be16(payload.size());
+    Bytes hdr = {0x60, 0, 0, 0, plen[0], plen[1], proto, 64};
+    return Concat({hdr, src, dst, payload});
+}
+
+Bytes Transport(uint16_t sport, uint16_t dport, const Bytes& payload = {}) {
+    auto l = Be16(8 + payload.size());
+    return Concat({Be16(sport), Be16(dport), {l[0], l[1], 0, 0}, payload});
+}
+
+Bytes Ethernet(uint16_t ethertype, const Bytes& payload) {
+    return Concat({{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}, Be16(ethertype), payload});
+}
+
+const Bytes ADDR_A = {10, 0, 0, 1};
+const Bytes ADDR_B = {192, 168, 1, 2};
+const Bytes VTEP_A = {172, 16, 0, 1};
+const Bytes VTEP_B = {172, 16, 0, 2};
+const Bytes ADDR6_A = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+const Bytes ADDR6_B = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2};
+
+Bytes InnerTCP(bool reverse, uint16_t port = 443) {
+    return reverse ? IPv4(ADDR_B, ADDR_A, IPPROTO_TCP, Transport(port, 51000)) :
+                     IPv4(ADDR_A, ADDR_B, IPPROTO_TCP, Transport(51000, port));
+}
+
+Bytes VXLAN(const Bytes& inner, bool reverse = false) {
+    Bytes hdr = {0x08, 0, 0, 0, 0, 0, 42, 0};
+    auto udp = Transport(reverse ? 4789 : 33000, 4789, Concat({hdr, Ethernet(0x0800, inner)}));
+    return reverse ? IPv4(VTEP_B, VTEP_A, IPPROTO_UDP, udp) : IPv4(VTEP_A, VTEP_B, IPPROTO_UDP, udp);
+}
+
+// Checks that the program agrees with the reference and returns the hash.
+uint32_t Check(const Bytes& pkt) {
+    static const auto prog = BuildInnerHashFanoutProgram();
+    REQUIRE(! prog.empty());
+
+    auto h = InnerFlowHash(pkt.data(), pkt.size());
+    CHECK(RunProgram(prog, pkt) == h);
+    return h;
+}
+
+} // namespace
+
+TEST_CASE("plain flows are hashed symmetrically") {
+    auto h = Check(InnerTCP(false));
+    CHECK(h != 0);
+    CHECK(Check(InnerTCP(true)) == h);
+    CHECK(Check(InnerTCP(false, 80)) != h);
+
+    auto h6 = Check(IPv6(ADDR6_A, ADDR6_B, IPPROTO_UDP, Transport(5353, 53)));
+    CHECK(Check(IPv6(ADDR6_B, ADDR6_A, IPPROTO_UDP, Transport(53, 5353))) == h6);
+
+    // Fragments only hash addresses and protocol.
+    auto frag = Check(IPv4(ADDR_A, ADDR_B, IPPROTO_UDP, Transport(1, 2), 0x2000));
+    CHECK(Check(IPv4(ADDR_B, ADDR_A, IPPROTO_UDP, Transport(3, 4), 0x0010)) == frag);
+}
+
+TEST_CASE("vxlan and geneve") {
+    auto h = Check(InnerTCP(false));
+
+    CHECK(Check(VXLAN(InnerTCP(false))) == h);
+    CHECK(Check(VXLAN(InnerTCP(true), true)) == h);
+    CHECK(Check(VXLAN(InnerTCP(false, 80))) != h);
+
+    // Geneve with one 8-byte option and an Ethernet payload.
+    Bytes geneve = {0x02, 0, 0x65, 0x58, 0, 0, 42, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    auto udp = Transport(33000, 6081, Concat({geneve, Ethernet(0x0800, InnerTCP(true))}));
+    CHECK(Check(IPv6(ADDR6_A, ADDR6_B, IPPROTO_UDP, udp)) == h);
+
+    // Geneve carrying IP directly.
+    Bytes geneve_ip = {0, 0, 0x08, 0x00, 0, 0, 42, 0};
+    udp = Transport(33000, 6081, Concat({geneve_ip, InnerTCP(false)}));
+    CHECK(Check(IPv4(VTEP_A, VTEP_B, IPPROTO_UDP, udp)) == h);
+}
+
+TEST_CASE("gtp") {
+    auto h = Check(InnerTCP(false));
+
+    Bytes gtp = {0x30, 0xff, 0, 0, 0, 0, 0, 1};
+    CHECK(Check(IPv4(VTEP_A, VTEP_B, IPPROTO_UDP, Transport(2152, 2152, Concat({gtp, InnerTCP(true)})))) == h);
+
+    // Sequence number and a PDU session container extension header.
+    Bytes gtp_ext = {0x36, 0xff, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0x85, 1, 0x10, 0x09, 0};
+    CHECK(Check(IPv4(VTEP_B, VTEP_A, IPPROTO_UDP, Transport(2152, 2152, Concat({gtp_ext, InnerTCP(false)})))) == h);
+
+    // Control messages are hashed over the outer headers.
+    Bytes echo = {0x32, 0x01, 0, 4, 0, 0, 0, 0, 0, 1, 0, 0};
+    auto outer = IPv4(VTEP_A, VTEP_B, IPPROTO_UDP, Transport(2152, 2152, echo));
+    CHECK(Check(outer) != h);
+}
+
+TEST_CASE("gre") {
+    auto h = Check(InnerTCP(false));
+
+    Bytes gre = {0, 0, 0x08, 0x00};
+    CHECK(Check(IPv4(VTEP_A, VTEP_B, IPPROTO_GRE, Concat({gre, InnerTCP(false)}))) == h);
+
+    // Key and sequence number present, transparent Ethernet bridging.
+    Bytes gre_teb = {0x30, 0, 0x65, 0x58, 0, 0, 0, 7, 0, 0, 0, 1};
+    CHECK(Check(IPv4(VTEP_B, VTEP_A, IPPROTO_GRE, Concat({gre_teb, Ethernet(0x0800, InnerTCP(true))}))) == h);
+
+    // Version 1 (PPTP) isn't looked into.
+    Bytes pptp = {0x30, 0x81, 0x88, 0x0b, 0, 0, 0, 7, 0, 0, 0, 1};
+    CHECK(Check(IPv4(VTEP_A, VTEP_B, IPPROTO_GRE, Concat({pptp, InnerTCP(false)}))) != h);
+}
+
+TEST_CASE("malformed packets") {
+    auto vxlan = VXLAN(InnerTCP(false));
+
+    for ( size_t len = 0; len < vxlan.size(); ++len )
+        Check(Bytes(vxlan.begin(), vxlan.begin() + len));
+
+    CHECK(Check({}) == 0);
+    CHECK(Check({0x10, 0, 0, 0}) == 0);
+
+    // A VXLAN payload that isn't IP falls back to the outer headers.
+    Bytes hdr = {0x08, 0, 0, 0, 0, 0, 42, 0};
+    auto arp = IPv4(VTEP_A, VTEP_B, IPPROTO_UDP, Transport(33000, 4789, Concat({hdr, Ethernet(0x0806, Bytes(28))})));
+    auto outer = IPv4(VTEP_A, VTEP_B, IPPROTO_UDP, Transport(33000, 4789, Bytes(50)));
+    CHECK(Check(arp) == Check(outer));
+}
+
+TEST_SUITE_END();
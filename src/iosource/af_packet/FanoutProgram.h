@@ -0,0 +1,44 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+extern "C" {
+#include <linux/filter.h> // sock_filter, SKF_NET_OFF
+#include <sys/types.h>
+}
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace zeek::iosource::af_packet {
+
+/**
+ * Builds the classic BPF program used by the FANOUT_INNER_HASH mode.
+ *
+ * The program looks through VXLAN (UDP 4789), Geneve (UDP 6081), GTPv1-U
+ * (UDP 2152, up to two extension headers) and GRE (version 0, IP or
+ * transparent Ethernet bridging payloads) and returns a symmetric hash over
+ * the inner IPv4/IPv6 addresses, protocol and TCP/UDP/SCTP ports. Packets
+ * that aren't tunneled, or whose inner payload isn't IP, are hashed over
+ * their outer headers instead. All loads are relative to the network header,
+ * so the program doesn't depend on the link layer or VLAN tagging.
+ *
+ * @return The program's instructions, or an empty vector if it could not
+ * be assembled.
+ */
+std::vector<sock_filter> BuildInnerHashFanoutProgram();
+
+/**
+ * Userspace reference implementation of the hash computed by the program
+ * returned from BuildInnerHashFanoutProgram(). Packets that are truncated
+ * in a way that makes the kernel abort the program hash to 0.
+ *
+ * @param data The packet, starting at its network layer header.
+ * @param len The number of bytes available at *data*.
+ *
+ * @return The hash value the fanout program computes for the packet.
+ */
+uint32_t InnerFlowHash(const u_char* data, size_t len);
+
+} // namespace zeek::iosource::af_packet
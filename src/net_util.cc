@@ -6,6 +6,7 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <cstring>
 #include <memory>
 
 #include "zeek/IP.h"
@@ -26,6 +27,135 @@ const char* transport_proto_string(TransportProto proto) {
 
 namespace zeek {
 
+namespace {
+
+// Adds up the given data as 16-bit words in native byte order, as if it
+// started at an even offset and with an odd trailing byte padded by zero.
+// The bulk of the data is added as 64-bit words with end-around carry into
+// two independent accumulators. Because of the ones' complement sum's
+// associativity, folding the result down to 16 bits gives the same value as
+// adding up 16-bit words directly.
+uint64_t ones_complement_sum(const uint8_t* data, size_t len) {
+    auto add = [](uint64_t& acc, uint64_t w) {
+        acc += w;
+        acc += (acc < w);
+    };
+
+    uint64_t acc0 = 0;
+    uint64_t acc1 = 0;
+
+    while ( len >= 16 ) {
+        uint64_t w0;
+        uint64_t w1;
+        memcpy(&w0, data, sizeof(w0));
+        memcpy(&w1, data + 8, sizeof(w1));
+        add(acc0, w0);
+        add(acc1, w1);
+        data += 16;
+        len -= 16;
+    }
+
+    uint64_t sum = (acc0 & 0xffffffff) + (acc0 >> 32) + (acc1 & 0xffffffff) + (acc1 >> 32);
+
+    while ( len >= 4 ) {
+        uint32_t w;
+        memcpy(&w, data, sizeof(w));
+        sum += w;
+        data += 4;
+        len -= 4;
+    }
+
+    if ( len >= 2 ) {
+        uint16_t w;
+        memcpy(&w, data, sizeof(w));
+        sum += w;
+        data += 2;
+        len -= 2;
+    }
+
+    if ( len ) {
+        uint8_t last[2] = {data[0], 0};
+        uint16_t w;
+        memcpy(&w, last, sizeof(w));
+        sum += w;
+    }
+
+    return sum;
+}
+
+uint16_t fold_ones_complement_sum(uint64_t sum) {
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return static_cast<uint16_t>(sum);
+}
+
+} // namespace
+
+uint16_t detail::in_cksum(const checksum_block* blocks, int num_blocks) {
+    uint64_t sum = 0;
+    bool odd = false;
+
+    for ( int i = 0; i < num_blocks; ++i ) {
+        if ( blocks[i].len <= 0 )
+            continue;
+
+        uint16_t block_sum = fold_ones_complement_sum(ones_complement_sum(blocks[i].block, blocks[i].len));
+
+        // A block starting at an odd offset pairs its bytes the other way
+        // around, which for the ones' complement sum amounts to swapping
+        // the bytes of its partial sum (RFC 1071).
+        if ( odd )
+            block_sum = static_cast<uint16_t>((block_sum << 8) | (block_sum >> 8));
+
+        sum += block_sum;
+
+        if ( blocks[i].len & 1 )
+            odd = ! odd;
+    }
+
+    return fold_ones_complement_sum(sum);
+}
+
+TEST_CASE("in_cksum") {
+    // Example from RFC 1071, section 3.
+    const uint8_t rfc[] = {0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7};
+    CHECK(ntohs(detail::in_cksum(rfc, sizeof(rfc))) == 0xddf2);
+    CHECK(detail::in_cksum(rfc, 0) == 0);
+
+    // An IPv4 header including a valid checksum sums up to 0xffff.
+    const uint8_t ip4[] = {0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+                           0xb8, 0x61, 0xc0, 0xa8, 0x00, 0x01, 0xc0, 0xa8, 0x00, 0xc7};
+    CHECK(detail::in_cksum(ip4, sizeof(ip4)) == 0xffff);
+
+    // Splitting the data into blocks, including at odd offsets, or starting
+    // at an unaligned address doesn't change the sum.
+    uint8_t data[301];
+    for ( size_t i = 0; i < sizeof(data); ++i )
+        data[i] = static_cast<uint8_t>(i * 37 + (i >> 3));
+
+    for ( int len : {1, 2, 3, 15, 16, 17, 33, 300} ) {
+        auto whole = detail::in_cksum(data, len);
+
+        for ( int split = 0; split <= len; split += 7 ) {
+            detail::checksum_block blocks[3] = {{data, split}, {data + split, (len - split) / 2},
+                                                {data + split + (len - split) / 2, len - split - (len - split) / 2}};
+            CHECK(detail::in_cksum(blocks, 3) == whole);
+        }
+
+        uint8_t shifted[sizeof(data) + 1];
+        memcpy(shifted + 1, data, len);
+        CHECK(detail::in_cksum(shifted + 1, len) == whole);
+    }
+
+    // End-around carries.
+    uint8_t ones[64];
+    memset(ones, 0xff, sizeof(ones));
+    CHECK(detail::in_cksum(ones, sizeof(ones)) == 0xffff);
+    CHECK(ntohs(detail::in_cksum(ones, 3)) == 0xff00);
+}
+
 uint16_t detail::ip4_in_cksum(const IPAddr& src, const IPAddr& dst, uint8_t next_proto, const uint8_t* data, int len) {
     constexpr auto nblocks = 2;
     detail::checksum_block blocks[nblocks];
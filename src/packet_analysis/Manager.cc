@@ -114,6 +114,10 @@ void Manager::ProcessPacket(Packet* packet) {
         dumped_packet = true;
     }
 
+    // Packets of shunted flows only update their connection's counters.
+    if ( ! shunt_table.Empty() && shunt_table.Process(packet) )
+        return;
+
     // Start packet analysis
     analyzer_stack.clear();
     root_analyzer->ForwardPacket(packet->cap_len, packet->data, packet, packet->link_type);
@@ -11,6 +11,7 @@
 #include "zeek/iosource/Packet.h"
 #include "zeek/packet_analysis/Component.h"
 #include "zeek/packet_analysis/Dispatcher.h"
+#include "zeek/packet_analysis/ShuntTable.h"
 #include "zeek/plugin/ComponentManager.h"
 
 namespace zeek {
@@ -139,6 +140,11 @@ public:
 
     uint64_t PacketsProcessed() const { return num_packets_processed; }
 
+    /**
+     * Returns the table of flows whose packets get dropped before analysis.
+     */
+    ShuntTable& GetShuntTable() { return shunt_table; }
+
     /**
      * Records the given packet if a dumper is active.
      *
@@ -250,6 +256,7 @@ private:
     uint64_t unknown_first_bytes_count = 0;
 
     uint64_t total_not_processed = 0;
+    ShuntTable shunt_table;
     iosource::PktDumper* unprocessed_dumper = nullptr;
 
     struct StackEntry {
@@ -0,0 +1,307 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/packet_analysis/ShuntTable.h"
+
+#include <netinet/in.h>
+#include <pcap.h>
+#include <utility>
+
+#include "zeek/Conn.h"
+#include "zeek/ID.h"
+#include "zeek/IP.h"
+#include "zeek/RunState.h"
+#include "zeek/TunnelEncapsulation.h"
+#include "zeek/Val.h"
+#include "zeek/analyzer/Manager.h"
+#include "zeek/analyzer/protocol/conn-size/ConnSize.h"
+#include "zeek/iosource/Packet.h"
+#include "zeek/packet_analysis/protocol/ip/SessionAdapter.h"
+
+#include "zeek/3rdparty/doctest.h"
+
+namespace zeek::packet_analysis {
+
+namespace detail {
+
+/**
+ * Attached to the session adapter of a shunted connection. Learns the flow's
+ * key from the packets that still reach the adapter, counts the packets the
+ * skipping adapter no longer delivers to ConnSize, and passes those counts
+ * on to ConnSize.
+ */
+class ShuntTap : public TapAnalyzer {
+public:
+    ShuntTap(ShuntTable* table, Connection* conn) : table(table), conn(conn) {
+        // ConnSize owns the counters and rewrites them whenever the record
+        // is refreshed, so skipped packets get handed over to it rather than
+        // patching the record ourselves. Looking it up once keeps that off
+        // the per-packet path.
+        static zeek::Tag connsize_tag = analyzer_mgr->GetComponentTag("CONNSIZE");
+        conn_size = static_cast<analyzer::conn_size::ConnSize_Analyzer*>(conn->FindAnalyzer(connsize_tag));
+    }
+
+    void TapPacket(const Packet& pkt, PacketAction action, SkipReason skip_reason) override {
+        if ( action != PacketAction::Skip || skip_reason != SkipReason::SkipProcessing )
+            return;
+
+        Count(pkt.is_orig, pkt.ip_hdr->TotalLen());
+
+        if ( learned || (pkt.encap && pkt.encap->Depth() > 0) )
+            return;
+
+        ShuntTable::FlowKey key;
+        bool forward;
+        uint32_t ip_len;
+
+        if ( ! ShuntTable::ParseFlow(&pkt, &key, &forward, &ip_len) )
+            return;
+
+        table->Learn(this, key, forward == pkt.is_orig);
+        learned = true;
+    }
+
+    void Done() override { table->Forget(this); }
+
+    void Count(bool is_orig, uint32_t ip_len) {
+        if ( conn_size )
+            conn_size->AddSkipped(is_orig, 1, ip_len);
+
+        conn->InvalidateVal();
+    }
+
+    Connection* GetConnection() const { return conn; }
+    const ShuntTable::FlowKey& Key() const { return key; }
+    bool Learned() const { return learned; }
+
+private:
+    friend class zeek::packet_analysis::ShuntTable;
+
+    ShuntTable* table;
+    Connection* conn;
+    analyzer::conn_size::ConnSize_Analyzer* conn_size = nullptr;
+    ShuntTable::FlowKey key = {};
+    bool learned = false;
+};
+
+} // namespace detail
+
+namespace {
+
+constexpr uint16_t ETHERTYPE_IPV4 = 0x0800;
+constexpr uint16_t ETHERTYPE_IPV6 = 0x86dd;
+constexpr uint16_t ETHERTYPE_VLAN = 0x8100;
+constexpr uint16_t ETHERTYPE_QINQ = 0x88a8;
+constexpr uint16_t ETHERTYPE_QINQ_OLD = 0x9100;
+constexpr uint8_t TCP_CONTROL_FLAGS = 0x07; // FIN, SYN, RST
+
+uint16_t Get16(const u_char* p) { return (p[0] << 8) | p[1]; }
+
+} // namespace
+
+bool ShuntTable::ParseFlow(const Packet* pkt, FlowKey* key, bool* forward, uint32_t* ip_len) {
+    if ( pkt->link_type != DLT_EN10MB || pkt->cap_len < 14 )
+        return false;
+
+    const u_char* data = pkt->data;
+    const u_char* end = pkt->data + pkt->cap_len;
+
+    memset(key, 0, sizeof(*key));
+
+    uint16_t ethertype = Get16(data + 12);
+    data += 14;
+
+    for ( auto* vlan : {&key->vlan, &key->inner_vlan} ) {
+        if ( ethertype != ETHERTYPE_VLAN && ethertype != ETHERTYPE_QINQ && ethertype != ETHERTYPE_QINQ_OLD )
+            break;
+
+        if ( end - data < 4 )
+            return false;
+
+        *vlan = Get16(data) & 0x0fff;
+        ethertype = Get16(data + 2);
+        data += 4;
+    }
+
+    const u_char* src;
+    const u_char* dst;
+    size_t addr_len;
+    const u_char* l4;
+
+    if ( ethertype == ETHERTYPE_IPV4 ) {
+        if ( end - data < 20 || (data[0] >> 4) != 4 )
+            return false;
+
+        size_t hdr_len = (data[0] & 0x0f) * 4;
+
+        // Fragments need reassembly.
+        if ( hdr_len < 20 || (Get16(data + 6) & 0x3fff) )
+            return false;
+
+        key->proto = data[9];
+        *ip_len = Get16(data + 2);
+        src = data + 12;
+        dst = data + 16;
+        addr_len = 4;
+        l4 = data + hdr_len;
+    }
+    else if ( ethertype == ETHERTYPE_IPV6 ) {
+        if ( end - data < 40 || (data[0] >> 4) != 6 )
+            return false;
+
+        // Extension headers aren't walked.
+        key->proto = data[6];
+        *ip_len = Get16(data + 4) + 40;
+        src = data + 8;
+        dst = data + 24;
+        addr_len = 16;
+        l4 = data + 40;
+    }
+    else
+        return false;
+
+    if ( key->proto == IPPROTO_TCP ) {
+        if ( end - l4 < 14 || (l4[13] & TCP_CONTROL_FLAGS) )
+            return false;
+    }
+    else if ( key->proto == IPPROTO_UDP ) {
+        if ( end - l4 < 4 )
+            return false;
+    }
+    else
+        return false;
+
+    uint16_t sport = Get16(l4);
+    uint16_t dport = Get16(l4 + 2);
+
+    int c = memcmp(src, dst, addr_len);
+    *forward = c < 0 || (c == 0 && sport <= dport);
+
+    if ( ! *forward ) {
+        std::swap(src, dst);
+        std::swap(sport, dport);
+    }
+
+    memcpy(key->addrs[0], src, addr_len);
+    memcpy(key->addrs[1], dst, addr_len);
+    key->ports[0] = sport;
+    key->ports[1] = dport;
+
+    return true;
+}
+
+bool ShuntTable::Shunt(Connection* conn) {
+    auto* adapter = conn->GetSessionAdapter();
+
+    if ( ! adapter )
+        return false;
+
+    adapter->SetSkip(true);
+
+    if ( conns.contains(conn) )
+        return true;
+
+    auto tap = std::make_unique<detail::ShuntTap>(this, conn);
+    conns.emplace(conn, tap.get());
+    adapter->AddTapAnalyzer(std::move(tap));
+    return true;
+}
+
+void ShuntTable::ConnSizeDone(const Connection* conn) {
+    if ( auto it = conns.find(conn); it != conns.end() )
+        it->second->conn_size = nullptr;
+}
+
+bool ShuntTable::Process(Packet* pkt) {
+    FlowKey key;
+    bool forward;
+    uint32_t ip_len;
+
+    if ( ! ParseFlow(pkt, &key, &forward, &ip_len) )
+        return false;
+
+    auto it = flows.find(key);
+    if ( it == flows.end() )
+        return false;
+
+    auto* tap = it->second.tap;
+    tap->Count(forward == it->second.orig_is_first, ip_len);
+    tap->GetConnection()->SetLastTime(run_state::processing_start_time);
+
+    pkt->processed = true;
+    ++packets_shunted;
+    return true;
+}
+
+void ShuntTable::Learn(detail::ShuntTap* tap, const FlowKey& key, bool orig_is_first) {
+    // A key that's already taken belongs to a connection that's about to be
+    // replaced; leave it alone until that one is done.
+    if ( ! flows.emplace(key, Entry{tap, orig_is_first}).second )
+        return;
+
+    tap->key = key;
+}
+
+void ShuntTable::Forget(detail::ShuntTap* tap) {
+    if ( tap->Learned() ) {
+        auto it = flows.find(tap->Key());
+        if ( it != flows.end() && it->second.tap == tap )
+            flows.erase(it);
+    }
+
+    conns.erase(tap->GetConnection());
+}
+
+} // namespace zeek::packet_analysis
+
+TEST_SUITE_BEGIN("shunt table");
+
+namespace {
+
+using zeek::packet_analysis::ShuntTable;
+
+std::vector<u_char> TCPPacket(uint8_t a, uint16_t sport, uint8_t b, uint16_t dport, uint8_t flags, bool vlan) {
+    std::vector<u_char> pkt(12, 0);
+
+    if ( vlan )
+        pkt.insert(pkt.end(), {0x81, 0x00, 0x00, 0x2a});
+
+    pkt.insert(pkt.end(), {0x08, 0x00, 0x45, 0, 0, 40, 0, 0, 0x40, 0, 64, IPPROTO_TCP, 0, 0, 10, 0, 0, a, 10, 0, 0, b,
+                           static_cast<u_char>(sport >> 8), static_cast<u_char>(sport), static_cast<u_char>(dport >> 8),
+                           static_cast<u_char>(dport), 0, 0, 0, 0, 0, 0, 0, 0, 0x50, flags, 0, 0, 0, 0, 0, 0});
+    return pkt;
+}
+
+bool Parse(const std::vector<u_char>& data, ShuntTable::FlowKey* key, bool* forward, uint32_t* ip_len) {
+    pkt_timeval ts = {0, 0};
+    zeek::Packet pkt(DLT_EN10MB, &ts, data.size(), data.size(), data.data());
+    return ShuntTable::ParseFlow(&pkt, key, forward, ip_len);
+}
+
+} // namespace
+
+TEST_CASE("flow keys are symmetric") {
+    ShuntTable::FlowKey k1, k2;
+    bool fwd1, fwd2;
+    uint32_t len;
+
+    auto p1 = TCPPacket(1, 51000, 2, 443, 0x10, false);
+    REQUIRE(Parse(p1, &k1, &fwd1, &len));
+    CHECK(len == 40);
+    REQUIRE(Parse(TCPPacket(2, 443, 1, 51000, 0x10, false), &k2, &fwd2, &len));
+    CHECK(k1 == k2);
+    CHECK(fwd1 != fwd2);
+
+    // VLANs are part of the key.
+    REQUIRE(Parse(TCPPacket(1, 51000, 2, 443, 0x10, true), &k2, &fwd2, &len));
+    CHECK_FALSE(k1 == k2);
+    CHECK(k2.vlan == 42);
+
+    // Connection control segments take the regular path.
+    CHECK_FALSE(Parse(TCPPacket(1, 51000, 2, 443, 0x11, false), &k2, &fwd2, &len));
+
+    // Truncated packets don't qualify.
+    p1.resize(40);
+    CHECK_FALSE(Parse(p1, &k2, &fwd2, &len));
+}
+
+TEST_SUITE_END();
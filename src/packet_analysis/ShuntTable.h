@@ -0,0 +1,133 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+namespace zeek {
+
+class Connection;
+class Packet;
+
+namespace packet_analysis {
+
+namespace detail {
+class ShuntTap;
+}
+
+/**
+ * A per-process table of shunted flows. Packets of shunted flows are dropped
+ * at the very start of packet analysis, before any packet analyzer or session
+ * lookup runs, while the connection's packet and IP byte counters and its
+ * last activity time continue to be updated.
+ *
+ * Shunting a connection implies skip_further_processing(). The table entry is
+ * learned from the next packet of the connection that still takes the regular
+ * path, so that the lookup key always matches what the early check extracts
+ * from raw packets. Only untunneled TCP and UDP over Ethernet (with up to two
+ * VLAN tags) qualifies; TCP SYN, FIN and RST segments and IP fragments always
+ * take the regular path.
+ */
+class ShuntTable {
+public:
+    /**
+     * Shunts a connection.
+     *
+     * @param conn The connection.
+     *
+     * @return False if the connection has no session adapter to attach to.
+     */
+    bool Shunt(Connection* conn);
+
+    /**
+     * Returns true if the given connection was shunted.
+     */
+    bool IsShunted(const Connection* conn) const { return conns.contains(conn); }
+
+    /**
+     * Drops the packet if it belongs to a shunted flow, updating the flow's
+     * counters.
+     *
+     * @param pkt The packet to check.
+     *
+     * @return True if the packet was consumed and must not be processed
+     * further.
+     */
+    bool Process(Packet* pkt);
+
+    /**
+     * Called by a connection's ConnSize analyzer once it's done, so that
+     * packets of the shunted connection no longer get counted there.
+     *
+     * @param conn The connection.
+     */
+    void ConnSizeDone(const Connection* conn);
+
+    /**
+     * Returns true if no flows are currently shunted.
+     */
+    bool Empty() const { return conns.empty(); }
+
+    /**
+     * Returns the number of packets dropped early so far.
+     */
+    uint64_t PacketsShunted() const { return packets_shunted; }
+
+    /**
+     * The lookup key of a flow, with its endpoints in canonical order so
+     * that both directions map to the same key.
+     */
+    struct FlowKey {
+        uint8_t addrs[2][16];
+        uint16_t ports[2];
+        uint16_t vlan;
+        uint16_t inner_vlan;
+        uint8_t proto;
+        uint8_t pad[3];
+
+        bool operator==(const FlowKey& other) const { return memcmp(this, &other, sizeof(*this)) == 0; }
+    };
+
+    /**
+     * Extracts the flow key of a raw packet.
+     *
+     * @param pkt The packet, which may not have been analyzed yet.
+     *
+     * @param key Set to the flow's key.
+     *
+     * @param forward Set to true if the packet's source is the key's first
+     * endpoint.
+     *
+     * @param ip_len Set to the total length of the packet's IP datagram.
+     *
+     * @return False if the packet doesn't qualify for shunting.
+     */
+    static bool ParseFlow(const Packet* pkt, FlowKey* key, bool* forward, uint32_t* ip_len);
+
+private:
+    friend class detail::ShuntTap;
+
+    struct FlowKeyHash {
+        size_t operator()(const FlowKey& k) const {
+            return std::hash<std::string_view>{}(std::string_view(reinterpret_cast<const char*>(&k), sizeof(k)));
+        }
+    };
+
+    struct Entry {
+        detail::ShuntTap* tap;
+        bool orig_is_first;
+    };
+
+    void Learn(detail::ShuntTap* tap, const FlowKey& key, bool orig_is_first);
+    void Forget(detail::ShuntTap* tap);
+
+    std::unordered_map<FlowKey, Entry, FlowKeyHash> flows;
+    std::unordered_map<const Connection*, detail::ShuntTap*> conns;
+    uint64_t packets_shunted = 0;
+};
+
+} // namespace packet_analysis
+} // namespace zeek
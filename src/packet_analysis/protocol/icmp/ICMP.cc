@@ -189,8 +189,8 @@ void ICMPAnalyzer::NextICMP6(double t, const struct icmp* icmpp, int len, int ca
 
 void ICMPAnalyzer::ICMP_Sent(const struct icmp* icmpp, int len, int caplen, int icmpv6, const u_char* data,
                              const IP_Hdr* ip_hdr, ICMPSessionAdapter* adapter) {
-    if ( icmp_sent )
-        adapter->EnqueueConnEvent(icmp_sent, adapter->ConnVal(), BuildInfo(icmpp, len, icmpv6, ip_hdr));
+    adapter->EnqueueConnEvent(icmp_sent,
+                              [&]() { return zeek::Args{adapter->ConnVal(), BuildInfo(icmpp, len, icmpv6, ip_hdr)}; });
 
     if ( icmp_sent_payload ) {
         String* payload = new String(data, std::min(len, caplen), false);
@@ -663,9 +663,10 @@ void ICMPAnalyzer::Context4(double t, const struct icmp* icmpp, int len, int cap
         case ICMP_TIMXCEED: f = icmp_time_exceeded; break;
     }
 
-    if ( f )
-        adapter->EnqueueConnEvent(f, adapter->ConnVal(), BuildInfo(icmpp, len, false, ip_hdr),
-                                  val_mgr->Count(icmpp->icmp_code), ExtractICMP4Context(caplen, data));
+    adapter->EnqueueConnEvent(f, [&]() {
+        return zeek::Args{adapter->ConnVal(), BuildInfo(icmpp, len, false, ip_hdr), val_mgr->Count(icmpp->icmp_code),
+                          ExtractICMP4Context(caplen, data)};
+    });
 }
 
 void ICMPAnalyzer::Context6(double t, const struct icmp* icmpp, int len, int caplen, const u_char*& data,
@@ -684,9 +685,10 @@ void ICMPAnalyzer::Context6(double t, const struct icmp* icmpp, int len, int cap
         default: f = icmp_error_message; break;
     }
 
-    if ( f )
-        adapter->EnqueueConnEvent(f, adapter->ConnVal(), BuildInfo(icmpp, len, true, ip_hdr),
-                                  val_mgr->Count(icmpp->icmp_code), ExtractICMP6Context(caplen, data));
+    adapter->EnqueueConnEvent(f, [&]() {
+        return zeek::Args{adapter->ConnVal(), BuildInfo(icmpp, len, true, ip_hdr), val_mgr->Count(icmpp->icmp_code),
+                          ExtractICMP6Context(caplen, data)};
+    });
 }
 
 zeek::VectorValPtr ICMPAnalyzer::BuildNDOptionsVal(int caplen, const u_char* data, ICMPSessionAdapter* adapter) {
@@ -51,6 +51,8 @@ void ICMPSessionAdapter::UpdateEndpointVal(RecordVal* endp, bool is_orig) {
 }
 
 void ICMPSessionAdapter::UpdateLength(bool is_orig, int len) {
+    Conn()->InvalidateVal();
+
     int& len_stat = is_orig ? request_len : reply_len;
     if ( len_stat < 0 )
         len_stat = len;
@@ -5,6 +5,7 @@
 #include <cinttypes>
 
 #include "zeek/Conn.h"
+#include "zeek/Event.h"
 #include "zeek/RunState.h"
 #include "zeek/Val.h"
 #include "zeek/analyzer/Manager.h"
@@ -18,6 +19,12 @@
 using namespace zeek;
 using namespace zeek::packet_analysis::IP;
 
+static zeek::detail::EventCoalescer& new_packet_batcher() {
+    // Constructed on first use, once the event handlers exist.
+    static zeek::detail::EventCoalescer batcher(new_packet_batch);
+    return batcher;
+}
+
 IPBasedAnalyzer::IPBasedAnalyzer(const char* name, TransportProto proto, uint32_t mask, bool report_unknown_protocols)
     : zeek::packet_analysis::Analyzer(name, report_unknown_protocols), transport(proto), server_port_mask(mask) {}
 
@@ -78,6 +85,9 @@ bool IPBasedAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* pkt
     bool is_orig = (src_addr == conn->OrigAddr()) && (src_port == conn->OrigPort());
     pkt->is_orig = is_orig;
 
+    // Packet counters and timestamps are about to move.
+    conn->InvalidateVal();
+
     conn->CheckFlowLabel(is_orig, ip_hdr->FlowLabel());
 
     zeek::ValPtr pkt_hdr_val;
@@ -87,9 +97,17 @@ bool IPBasedAnalyzer::AnalyzePacket(size_t len, const uint8_t* data, Packet* pkt
         conn->EnqueueEvent(ipv6_ext_headers, nullptr, conn->GetVal(), pkt_hdr_val);
     }
 
-    if ( new_packet )
-        conn->EnqueueEvent(new_packet, nullptr, conn->GetVal(),
-                           pkt_hdr_val ? std::move(pkt_hdr_val) : ip_hdr->ToPktHdrVal());
+    auto& batcher = new_packet_batcher();
+
+    if ( new_packet || batcher ) {
+        zeek::Args args{conn->GetVal(), pkt_hdr_val ? std::move(pkt_hdr_val) : ip_hdr->ToPktHdrVal()};
+
+        if ( batcher )
+            batcher.Add(args);
+
+        if ( new_packet )
+            conn->EnqueueEvent(new_packet, nullptr, std::move(args));
+    }
 
     conn->SetRecordPackets(true);
     conn->SetRecordContents(true);
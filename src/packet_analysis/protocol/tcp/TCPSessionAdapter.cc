@@ -4,6 +4,7 @@
 
 #include <cinttypes>
 
+#include "zeek/Event.h"
 #include "zeek/RunState.h"
 #include "zeek/Val.h"
 #include "zeek/analyzer/Manager.h"
@@ -23,6 +24,12 @@ constexpr int32_t TOO_LARGE_SEQ_DELTA = 1048576;
 using namespace zeek;
 using namespace zeek::packet_analysis::TCP;
 
+static zeek::detail::EventCoalescer& tcp_packet_batcher() {
+    // Constructed on first use, once the event handlers exist.
+    static zeek::detail::EventCoalescer batcher(tcp_packet_batch);
+    return batcher;
+}
+
 TCPSessionAdapter::TCPSessionAdapter(Connection* conn) : packet_analysis::IP::SessionAdapter("TCP", conn) {
     // Set a timer to eventually time out this connection.
     ADD_ANALYZER_TIMER(&TCPSessionAdapter::ExpireTimer, run_state::network_time + zeek::detail::tcp_SYN_timeout, false,
@@ -614,7 +621,7 @@ void TCPSessionAdapter::Process(bool is_orig, const struct tcphdr* tp, int len,
         // from flagging them in the connection history.
         peer->AckReceived(rel_ack);
 
-    if ( tcp_packet )
+    if ( tcp_packet || tcp_packet_batcher() )
         GeneratePacketEvent(rel_seq, rel_ack, data, len, remaining, is_orig, flags);
 
     if ( (tcp_option || tcp_options) && tcp_hdr_len > sizeof(*tp) )
@@ -983,11 +990,17 @@ void TCPSessionAdapter::UpdateStateMachine(double t, analyzer::tcp::TCP_Endpoint
 
 void TCPSessionAdapter::GeneratePacketEvent(uint64_t rel_seq, uint64_t rel_ack, const u_char* data, int len, int caplen,
                                             bool is_orig, analyzer::tcp::TCP_Flags flags) {
-    EnqueueConnEvent(tcp_packet, ConnVal(), val_mgr->Bool(is_orig), make_intrusive<StringVal>(flags.AsString()),
-                     val_mgr->Count(rel_seq), val_mgr->Count(flags.ACK() ? rel_ack : 0), val_mgr->Count(len),
-                     // We need the min() here because Ethernet padding can lead to
-                     // caplen > len.
-                     make_intrusive<StringVal>(std::min(caplen, len), reinterpret_cast<const char*>(data)));
+    zeek::Args args{ConnVal(), val_mgr->Bool(is_orig), make_intrusive<StringVal>(flags.AsString()),
+                    val_mgr->Count(rel_seq), val_mgr->Count(flags.ACK() ? rel_ack : 0), val_mgr->Count(len),
+                    // We need the min() here because Ethernet padding can lead to
+                    // caplen > len.
+                    make_intrusive<StringVal>(std::min(caplen, len), reinterpret_cast<const char*>(data))};
+
+    if ( auto& batcher = tcp_packet_batcher() )
+        batcher.Add(args);
+
+    if ( tcp_packet )
+        EnqueueConnEvent(tcp_packet, std::move(args));
 }
 
 bool TCPSessionAdapter::DeliverData(double t, const u_char* data, int len, int caplen, const IP_Hdr* ip,
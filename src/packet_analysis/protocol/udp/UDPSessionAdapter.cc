@@ -51,6 +51,8 @@ void UDPSessionAdapter::UpdateEndpointVal(RecordVal* endp, bool is_orig) {
 }
 
 void UDPSessionAdapter::UpdateLength(bool is_orig, int len) {
+    Conn()->InvalidateVal();
+
     if ( is_orig ) {
         if ( request_len < 0 )
             request_len = len;
@@ -287,6 +287,7 @@ static std::unordered_map<std::string, unsigned int> func_attrs = {
     {"fnv1a64", ATTR_FOLDABLE},
     {"generate_all_events", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"get_broker_stats", ATTR_NO_ZEEK_SIDE_EFFECTS},
+    {"get_conn_memory_stats", ATTR_NO_ZEEK_SIDE_EFFECTS},
     {"get_conn_stats", ATTR_NO_ZEEK_SIDE_EFFECTS},
     {"get_conn_transport_proto", ATTR_FOLDABLE},
     {"get_contents_file", ATTR_NO_ZEEK_SIDE_EFFECTS},
@@ -380,11 +381,13 @@ static std::unordered_map<std::string, unsigned int> func_attrs = {
     {"lookup_ID", ATTR_IDEMPOTENT},
     {"lookup_addr", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"lookup_autonomous_system", ATTR_NO_SCRIPT_SIDE_EFFECTS},
+    {"lookup_autonomous_systems", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"lookup_connection", ATTR_NO_ZEEK_SIDE_EFFECTS},
     {"lookup_connection_analyzer_id", ATTR_NO_ZEEK_SIDE_EFFECTS},
     {"lookup_hostname", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"lookup_hostname_txt", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"lookup_location", ATTR_NO_SCRIPT_SIDE_EFFECTS},
+    {"lookup_locations", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"lstrip", ATTR_FOLDABLE},
     {"mask_addr", ATTR_FOLDABLE},
     {"match_signatures", ATTR_NO_SCRIPT_SIDE_EFFECTS},
@@ -473,6 +476,7 @@ static std::unordered_map<std::string, unsigned int> func_attrs = {
     {"sha512_hash_finish", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"sha512_hash_init", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"sha512_hash_update", ATTR_NO_SCRIPT_SIDE_EFFECTS},
+    {"shunt_connection", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"skip_further_processing", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"skip_http_entity_data", ATTR_NO_SCRIPT_SIDE_EFFECTS},
     {"skip_smtp_data", ATTR_NO_SCRIPT_SIDE_EFFECTS},
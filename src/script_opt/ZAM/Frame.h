@@ -4,10 +4,13 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "zeek/Attr.h"
 #include "zeek/ID.h"
+#include "zeek/ZVal.h"
 #include "zeek/util-types.h"
 
 namespace zeek::detail {
@@ -46,4 +49,73 @@ public:
 
 using FrameReMap = std::vector<FrameSharingInfo>;
 
+// A bump allocator for per-invocation state of ZAM bodies that can't use
+// pre-allocated state because they're (possibly) recursive, namely their
+// frames and step iterators.  That state is strictly created and destroyed
+// in LIFO order - including when a body is exited via an exception, since
+// it's owned by stack objects - so rather than a heap allocation per
+// invocation, we carve it out of a small number of large blocks that are
+// retained across invocations.
+template<typename T>
+class ZAMStackArena {
+public:
+    // Returns storage for "n" elements.  The elements are *not* reset
+    // from any previous use; it's up to the caller to initialize them.
+    T* Alloc(size_t n) {
+        while ( curr_block < blocks.size() ) {
+            auto& b = blocks[curr_block];
+            if ( b.top + n <= b.size ) {
+                auto f = b.mem.get() + b.top;
+                b.top += n;
+                return f;
+            }
+
+            if ( b.top == 0 ) {
+                // An unused block that's too small.  We know nothing
+                // lives in it, so we can replace it with a larger one.
+                b = Block(n);
+                b.top = n;
+                return b.mem.get();
+            }
+
+            ++curr_block;
+        }
+
+        blocks.emplace_back(std::max(n, DEFAULT_BLOCK_SLOTS));
+        auto& b = blocks.back();
+        b.top = n;
+        return b.mem.get();
+    }
+
+    // Returns the most recently allocated storage for "n" elements back
+    // to the arena.
+    void Release(T* f, size_t n) {
+        auto& b = blocks[curr_block];
+        ASSERT(b.top >= n && b.mem.get() + b.top - n == f);
+        b.top -= n;
+
+        // Fall back to the previous block, which might have room that
+        // wasn't sufficient for the allocation that led us to this one, but
+        // will be for later allocations.
+        if ( b.top == 0 && curr_block > 0 )
+            --curr_block;
+    }
+
+private:
+    static constexpr size_t DEFAULT_BLOCK_SLOTS = 4096;
+
+    struct Block {
+        Block(size_t _size) : mem(std::make_unique<T[]>(_size)), size(_size) {}
+
+        std::unique_ptr<T[]> mem;
+        size_t size;
+        size_t top = 0;
+    };
+
+    std::vector<Block> blocks;
+    size_t curr_block = 0;
+};
+
+using ZAMFrameArena = ZAMStackArena<ZVal>;
+
 } // namespace zeek::detail
@@ -242,15 +242,18 @@ ZBody::ZBody(std::string _func_name, const ZAMCompiler* zc) : Stmt(STMT_ZAM) {
     double_cases = zc->GetCases<double>();
     str_cases = zc->GetCases<std::string>();
 
+    table_iters = zc->GetTableIters();
+    num_step_iters = zc->NumStepIters();
+
     if ( zc->NonRecursive() ) {
         fixed_frame = new ZVal[frame_size];
 
         for ( auto& ms : managed_slots )
             fixed_frame[ms].ClearManagedVal();
-    }
 
-    table_iters = zc->GetTableIters();
-    num_step_iters = zc->NumStepIters();
+        if ( num_step_iters > 0 )
+            fixed_step_iters = new StepIterInfo[num_step_iters];
+    }
 
     // It's a little weird doing this in the constructor, but unless
     // we add a general "initialize for ZAM" function, this is as good
@@ -271,6 +274,7 @@ ZBody::ZBody(std::string _func_name, const ZAMCompiler* zc) : Stmt(STMT_ZAM) {
 
 ZBody::~ZBody() {
     delete[] fixed_frame;
+    delete[] fixed_step_iters;
     delete[] insts;
     delete[] inst_cnt;
 }
@@ -307,20 +311,35 @@ std::shared_ptr<ProfVec> ZBody::BuildProfVec() const {
     return pv;
 }
 
+// Where the frames and step iterators of recursive bodies come from.
+static ZAMFrameArena frame_arena;
+static ZAMStackArena<StepIterInfo> step_iter_arena;
+
 // Helper class for managing ZBody state to ensure that memory is recovered
 // if a ZBody is exited via an exception.
 class ZBodyStateManager {
 public:
-    // If fixed_frame is nil then creates a dynamic frame.
-    ZBodyStateManager(ZVal* _fixed_frame, int frame_size, const std::vector<int>& _managed_slots,
-                      TableIterVec* _tiv_ptr)
-        : fixed_frame(_fixed_frame), managed_slots(_managed_slots), tiv_ptr(_tiv_ptr) {
-        if ( fixed_frame )
+    // If fixed_frame is nil then creates a dynamic frame, along with
+    // dynamic step iterators.
+    ZBodyStateManager(ZVal* _fixed_frame, int _frame_size, const std::vector<int>& _managed_slots,
+                      StepIterInfo* fixed_step_iters, int _num_step_iters, TableIterVec* _tiv_ptr)
+        : fixed_frame(_fixed_frame),
+          frame_size(_frame_size),
+          managed_slots(_managed_slots),
+          num_step_iters(_num_step_iters),
+          tiv_ptr(_tiv_ptr) {
+        if ( fixed_frame ) {
             frame = fixed_frame;
+            step_iters = fixed_step_iters;
+        }
         else {
-            frame = new ZVal[frame_size];
+            frame = frame_arena.Alloc(frame_size);
             for ( auto s : managed_slots )
                 frame[s].ClearManagedVal();
+
+            // StepIterInfo's get initialized when their loop starts.
+            if ( num_step_iters > 0 )
+                step_iters = step_iter_arena.Alloc(num_step_iters);
         }
     }
 
@@ -343,16 +362,24 @@ public:
             // Recover memory, no need to reset.
             for ( auto s : managed_slots )
                 ZVal::DeleteManagedType(frame[s]);
-            delete[] frame;
+
+            if ( step_iters )
+                step_iter_arena.Release(step_iters, num_step_iters);
+
+            frame_arena.Release(frame, frame_size);
         }
     }
 
     auto Frame() { return frame; }
+    auto StepIters() { return step_iters; }
 
 private:
     ZVal* fixed_frame;
     ZVal* frame;
+    int frame_size;
     const std::vector<int>& managed_slots;
+    StepIterInfo* step_iters = nullptr;
+    int num_step_iters;
     TableIterVec* tiv_ptr;
 };
 
@@ -395,9 +422,10 @@ ValPtr ZBody::Exec(Frame* f, StmtFlowType& flow) {
         }
     }
 
-    ZBodyStateManager state_mgr(fixed_frame, frame_size, managed_slots, &table_iters);
+    ZBodyStateManager state_mgr(fixed_frame, frame_size, managed_slots, fixed_step_iters, num_step_iters,
+                                &table_iters);
     std::unique_ptr<TableIterVec> local_table_iters;
-    std::vector<StepIterInfo> step_iters(num_step_iters);
+    StepIterInfo* step_iters = state_mgr.StepIters();
 
     // Points to the TableIterVec used to manage iteration over tables.
     // For non-recursive functions, we just use the static one, but
@@ -125,10 +125,11 @@ private:
     // functions they can be used directly.
     TableIterVec table_iters;
 
-    // Number of StepIterInfo's required by the function.  These we
-    // always create using a local stack variable, since they don't
-    // require any overhead or cleanup.
+    // Number of StepIterInfo's required by the function.  These don't
+    // require any cleanup, so for non-recursive functions we pre-allocate
+    // them like the frame, and otherwise take them from an arena.
     int num_step_iters;
+    StepIterInfo* fixed_step_iters = nullptr;
 
     std::vector<GlobalInfo> globals;
     int num_globals;
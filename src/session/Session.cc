@@ -63,13 +63,12 @@ Session::Session(double t, EventHandlerPtr timeout_event, EventHandlerPtr status
 }
 
 void Session::Event(EventHandlerPtr f, analyzer::Analyzer* analyzer, const char* name) {
-    if ( ! f )
-        return;
+    EnqueueEvent(f, analyzer, [this, name]() {
+        if ( name )
+            return zeek::Args{make_intrusive<StringVal>(name), GetVal()};
 
-    if ( name )
-        EnqueueEvent(f, analyzer, make_intrusive<StringVal>(name), GetVal());
-    else
-        EnqueueEvent(f, analyzer, GetVal());
+        return zeek::Args{GetVal()};
+    });
 }
 
 void Session::EnqueueEvent(EventHandlerPtr f, analyzer::Analyzer* a, Args args) {
@@ -183,7 +182,7 @@ void Session::InactivityTimer(double t) {
 }
 
 void Session::StatusUpdateTimer(double t) {
-    EnqueueEvent(session_status_update_event, nullptr, GetVal());
+    EnqueueEvent(session_status_update_event, nullptr, [this]() { return zeek::Args{GetVal()}; });
     ADD_TIMER(&Session::StatusUpdateTimer, run_state::network_time + session_status_update_interval, 0,
               zeek::detail::TIMER_CONN_STATUS_UPDATE);
 }
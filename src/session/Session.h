@@ -77,9 +77,25 @@ public:
     bool IsInSessionTable() const { return in_session_table; }
 
     double StartTime() const { return start_time; }
-    void SetStartTime(double t) { start_time = t; }
+    void SetStartTime(double t) {
+        start_time = t;
+        InvalidateVal();
+    }
     double LastTime() const { return last_time; }
-    void SetLastTime(double t) { last_time = t; }
+    void SetLastTime(double t) {
+        last_time = t;
+        InvalidateVal();
+    }
+
+    /**
+     * Marks the session's record value as out of date, so that the next
+     * GetVal() call refreshes it rather than returning it as is. Everything
+     * changing state that the record reflects needs to call this. Analyzer
+     * data delivery already does, so analyzers overriding UpdateConnVal()
+     * only need to if their state changes outside of that, such as in
+     * timers.
+     */
+    void InvalidateVal() { val_current = false; }
 
     // True if we should record subsequent packets (either headers or
     // in their entirety, depending on record_contents).  We still
@@ -133,6 +149,17 @@ public:
         return EnqueueEvent(h, analyzer, zeek::Args{std::forward<Args>(args)...});
     }
 
+    /**
+     * A version of EnqueueEvent() that only builds the argument list, such
+     * as the session's record value, if the event has any handlers.
+     */
+    template<class F>
+        requires std::is_invocable_r_v<zeek::Args, F>
+    void EnqueueEvent(EventHandlerPtr h, analyzer::Analyzer* analyzer, F&& make_args) {
+        if ( h )
+            EnqueueEvent(h, analyzer, std::forward<F>(make_args)());
+    }
+
     void Describe(ODesc* d) const override;
 
     /**
@@ -231,7 +258,10 @@ public:
      *
      * @param code Code to add
      */
-    void AddHistory(char code) { history += code; }
+    void AddHistory(char code) {
+        history += code;
+        InvalidateVal();
+    }
 
     /**
      * @return The current history value.
@@ -243,7 +273,10 @@ public:
      *
      * @param new_h The new history.
      */
-    void ReplaceHistory(std::string new_h) { history = std::move(new_h); }
+    void ReplaceHistory(std::string new_h) {
+        history = std::move(new_h);
+        InvalidateVal();
+    }
 
 protected:
     friend class detail::Timer;
@@ -293,6 +326,9 @@ protected:
     unsigned int record_current_packet : 1, record_current_content : 1;
     bool in_session_table;
 
+    // False if the record value needs refreshing on the next GetVal().
+    bool val_current = false;
+
     std::map<zeek::Tag, AnalyzerConfirmationState> analyzer_confirmations;
 
     uint32_t hist_seen;
@@ -5,6 +5,8 @@
 #include "zeek/spicy/manager.h"
 #include "zeek/spicy/runtime-support.h"
 
+#include "spicy.bif.h"
+
 using namespace zeek;
 using namespace zeek::spicy;
 using namespace zeek::spicy::rt;
@@ -84,6 +86,35 @@ void ProtocolAnalyzer::Process(bool is_orig, int len, const u_char* data) {
     }
 }
 
+void ProtocolAnalyzer::Coalesce(bool is_orig, int len, const u_char* data) {
+    const auto max_coalesce_bytes = BifConst::Spicy::max_coalesce_bytes;
+    auto& pending = (is_orig ? _originator : _responder).pending();
+
+    Flush(! is_orig);
+
+    if ( pending.empty() && static_cast<zeek_uint_t>(len) >= max_coalesce_bytes ) {
+        Process(is_orig, len, data);
+        return;
+    }
+
+    pending.append(reinterpret_cast<const char*>(data), len);
+
+    if ( pending.size() >= max_coalesce_bytes )
+        Flush(is_orig);
+}
+
+void ProtocolAnalyzer::Flush(bool is_orig) {
+    auto& pending = (is_orig ? _originator : _responder).pending();
+
+    if ( pending.empty() )
+        return;
+
+    // Take the data out first, parsing may lead back in here.
+    auto data = std::move(pending);
+    pending.clear();
+    Process(is_orig, static_cast<int>(data.size()), reinterpret_cast<const u_char*>(data.data()));
+}
+
 void ProtocolAnalyzer::Finish(bool is_orig) {
     auto* endp = is_orig ? &_originator : &_responder;
 
@@ -134,6 +165,9 @@ void TCP_Analyzer::Init() {
 }
 
 void TCP_Analyzer::Done() {
+    Flush(true);
+    Flush(false);
+
     analyzer::tcp::TCP_ApplicationAnalyzer::Done();
     ProtocolAnalyzer::Done();
 
@@ -144,7 +178,7 @@ void TCP_Analyzer::Done() {
 void TCP_Analyzer::DeliverStream(int len, const u_char* data, bool is_orig) {
     analyzer::tcp::TCP_ApplicationAnalyzer::DeliverStream(len, data, is_orig);
 
-    Process(is_orig, len, data);
+    Coalesce(is_orig, len, data);
 
     if ( originator().isFinished() && responder().isFinished() &&
          (! originator().isSkipping() || ! responder().isSkipping()) ) {
@@ -162,6 +196,7 @@ void TCP_Analyzer::DeliverStream(int len, const u_char* data, bool is_orig) {
 void TCP_Analyzer::Undelivered(uint64_t seq, int len, bool is_orig) {
     analyzer::tcp::TCP_ApplicationAnalyzer::Undelivered(seq, len, is_orig);
 
+    Flush(is_orig);
     Process(is_orig, len, nullptr);
 }
 
@@ -174,6 +209,7 @@ void TCP_Analyzer::FlipRoles() {
 
 void TCP_Analyzer::EndpointEOF(bool is_orig) {
     analyzer::tcp::TCP_ApplicationAnalyzer::EndpointEOF(is_orig);
+    Flush(is_orig);
     Finish(is_orig);
 }
 
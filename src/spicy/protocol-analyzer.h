@@ -50,12 +50,19 @@ public:
      */
     void DebugMsg(const std::string& msg) { debug(msg); }
 
+    /**
+     * Returns data held back from parsing so far, for feeding it in
+     * together with subsequent chunks.
+     */
+    auto& pending() { return _pending; }
+
 protected:
     // Overridden from driver::ParsingState.
     void debug(const std::string& msg) override;
 
 private:
     Cookie _cookie;
+    std::string _pending;
 };
 
 /** Base class for Spicy protocol analyzers. */
@@ -92,6 +99,25 @@ protected:
      */
     void Process(bool is_orig, int len, const u_char* data);
 
+    /**
+     * Like Process(), but holds back small chunks until they add up to
+     * `Spicy::max_coalesce_bytes`, so that the parser gets resumed once
+     * for all of them. Any data held back for the other side is processed
+     * first, so that parsing keeps following the order of the input.
+     *
+     * @param is_orig true to use originator-side endpoint state, false for responder
+     * @param len number of bytes valid in *data*
+     * @param data pointer to data
+     */
+    void Coalesce(bool is_orig, int len, const u_char* data);
+
+    /**
+     * Processes any data held back by Coalesce() for one side.
+     *
+     * @param is_orig true to flush originator-side data, false for responder
+     */
+    void Flush(bool is_orig);
+
     /**
      * Finalizes parsing. After calling this, no more data must be passed
      * into Process() for the corresponding side.
@@ -310,6 +310,9 @@ static void terminate_zeek() {
     // the termination process.
     file_mgr->Terminate();
 
+    // Raise any partial batches of coalesced events before zeek_done.
+    event_mgr.FlushCoalescedEvents();
+
     if ( zeek_done )
         event_mgr.Enqueue(zeek_done, Args{});
 
@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""
+Generate compression-pointer-reuse.pcap: two DNS responses, each on its own
+connection, whose names reuse compression pointers the analyzer resolved
+earlier in the same message.
+
+The first response chains names through pointers and then points at those
+names again from different depths. Run with dns_max_compression_chain_depth=5,
+names reached through a reused pointer must hit the depth limit exactly where
+following the pointers again would.
+
+The second response has a name whose label contains bytes that read as a
+pointer back to the name itself. Pointing at the whole name resolves fine,
+but pointing at the embedded pointer leaves it too little room, which must
+still be reported even though the name was resolved before.
+"""
+
+import struct
+from pathlib import Path
+
+from scapy.all import IP, UDP, Ether, Raw, wrpcap
+
+SRC = "1.2.3.4"
+DST = "5.6.7.8"
+
+
+def ptr(offset):
+    """2-byte DNS compression pointer."""
+    assert offset < 0x3FFF
+    return bytes([0xC0 | (offset >> 8), offset & 0xFF])
+
+
+def label(text):
+    return bytes([len(text)]) + text
+
+
+def rr(name_bytes, i):
+    """Build a DNS RR with type A, class IN, ttl 300, address 127.0.0.<i>."""
+    return name_bytes + struct.pack("!HHIH", 1, 1, 300, 4) + bytes([127, 0, 0, i])
+
+
+def message(txid, names):
+    """
+    Builds a response with a single question and one A record per entry
+    of names. Each entry is called with the offsets of the RRs so far.
+    """
+    question = label(b"q") + b"\x00" + struct.pack("!HH", 1, 1)
+    payload = question
+    offsets = []
+
+    for i, name in enumerate(names):
+        offsets.append(12 + len(payload))
+        payload += rr(name(offsets), i + 1)
+
+    header = struct.pack("!HHHHHH", txid, 0x8180, 1, len(names), 0, 0)
+    return header + payload
+
+
+def chained_message():
+    return message(
+        0x1234,
+        [
+            lambda o: label(b"a") + b"\x00",
+            lambda o: label(b"b") + ptr(o[0]),
+            lambda o: label(b"c") + ptr(o[1]),
+            lambda o: label(b"d") + ptr(o[2]),
+            lambda o: ptr(o[3]),
+            lambda o: label(b"e") + ptr(o[4]),
+            lambda o: label(b"f") + ptr(o[5]),  # depth 6
+            lambda o: ptr(o[6]),  # depth 7
+            lambda o: ptr(o[2]),  # reuse from the top
+            lambda o: label(b"g") + ptr(o[4]),  # reuse, depth 5
+            lambda o: ptr(o[9]),  # depth 5, resolves [9] through a reused pointer
+            lambda o: label(b"h") + ptr(o[10]),  # depth 6 through [10]
+        ],
+    )
+
+
+def bounded_message():
+    # The first RR's name starts at offset 19 and is a single label
+    # "x\xc0\x13y", whose middle two bytes are a pointer to 19.
+    return message(
+        0x1235,
+        [
+            lambda o: label(b"x" + ptr(19) + b"y") + b"\x00",
+            lambda o: ptr(o[0]),
+            lambda o: ptr(o[0] + 2),
+        ],
+    )
+
+
+def main():
+    pkts = [
+        Ether()
+        / IP(src=SRC, dst=DST)
+        / UDP(sport=sport, dport=53)
+        / Raw(load=payload)
+        for sport, payload in [(12345, chained_message()), (12346, bounded_message())]
+    ]
+
+    out = Path(__file__).with_suffix("")
+    wrpcap(str(out), pkts)
+    print(f"Wrote {out}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+
+# Three HTTP connections, each transferring the same gzip-compressed body of
+# 8192 incompressible bytes in 500-byte segments. The first two fall into the
+# same second of network time, the third into the next one.
+
+import gzip
+
+from scapy.all import IP, TCP, Ether, Raw, wrpcap
+
+x = 12345
+body = bytearray()
+
+for _ in range(8192):
+    x = (x * 1103515245 + 12345) & 0x7FFFFFFF
+    body.append((x >> 16) & 0xFF)
+
+gz = gzip.compress(bytes(body), mtime=0)
+
+pkts = []
+
+
+def emit(t, src, dst, sport, dport, seq, ack, flags, payload=b""):
+    pkt = (
+        Ether(src="02:00:00:00:00:01", dst="02:00:00:00:00:02")
+        / IP(src=src, dst=dst, id=len(pkts) + 1, flags="DF")
+        / TCP(sport=sport, dport=dport, seq=seq, ack=ack, flags=flags, window=65535)
+    )
+
+    if payload:
+        pkt = pkt / Raw(payload)
+
+    pkt.time = t
+    pkts.append(pkt)
+
+
+def conn(t, sport):
+    c, s = "192.0.2.1", "198.51.100.1"
+    cs, ss = 1000, 5000
+    dt = 0.001
+
+    emit(t, c, s, sport, 80, cs, 0, "S")
+    emit(t + dt, s, c, 80, sport, ss, cs + 1, "SA")
+    cs += 1
+    ss += 1
+    t += 2 * dt
+    emit(t, c, s, sport, 80, cs, ss, "A")
+    t += dt
+
+    req = b"GET /data HTTP/1.1\r\nHost: example.com\r\n\r\n"
+    emit(t, c, s, sport, 80, cs, ss, "PA", req)
+    cs += len(req)
+    t += dt
+
+    hdr = (
+        b"HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n"
+        b"Content-Encoding: gzip\r\nContent-Length: %d\r\n\r\n" % len(gz)
+    )
+    emit(t, s, c, 80, sport, ss, cs, "PA", hdr)
+    ss += len(hdr)
+    t += dt
+
+    for i in range(0, len(gz), 500):
+        seg = gz[i : i + 500]
+        emit(t, s, c, 80, sport, ss, cs, "A", seg)
+        ss += len(seg)
+        t += dt
+
+    emit(t, c, s, sport, 80, cs, ss, "A")
+    emit(t + dt, c, s, sport, 80, cs, ss, "FA")
+    cs += 1
+    emit(t + 2 * dt, s, c, 80, sport, ss, cs, "FA")
+    ss += 1
+    emit(t + 3 * dt, c, s, sport, 80, cs, ss, "A")
+
+
+conn(1.1, 40001)
+conn(1.5, 40002)
+conn(2.1, 40003)
+
+wrpcap("gzip-multi-segment.pcap", pkts)
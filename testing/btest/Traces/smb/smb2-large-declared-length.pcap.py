@@ -0,0 +1,55 @@
+#!/usr/bin/env python3
+# Generates an SMB2 connection whose only NBSS frame declares a length far
+# beyond what is actually sent.
+import struct
+from pathlib import Path
+
+from scapy.all import IP, TCP, Ether, Raw, wrpcap
+
+OUT = Path(__file__).resolve().parent
+DECLARED_LEN = 0xFFFFFF
+
+
+def make_payload():
+    # NBSS session message header with a 24-bit length, then the start of
+    # an SMB2 header that never gets completed.
+    nbss = struct.pack(">B", 0) + DECLARED_LEN.to_bytes(3, "big")
+    smb2 = b"\xfeSMB" + struct.pack("<H", 64) + b"\x00" * 58
+    return nbss + smb2
+
+
+def write_pcap(payload):
+    c = ("10.0.1.1", 52000)
+    s = ("10.0.1.2", 445)
+    seq_c = 1000
+    seq_s = 2000
+    pkts = [
+        Ether()
+        / IP(src=c[0], dst=s[0])
+        / TCP(sport=c[1], dport=s[1], flags="S", seq=seq_c),
+        Ether()
+        / IP(src=s[0], dst=c[0])
+        / TCP(sport=s[1], dport=c[1], flags="SA", seq=seq_s, ack=seq_c + 1),
+        Ether()
+        / IP(src=c[0], dst=s[0])
+        / TCP(sport=c[1], dport=s[1], flags="A", seq=seq_c + 1, ack=seq_s + 1),
+        Ether()
+        / IP(src=c[0], dst=s[0])
+        / TCP(sport=c[1], dport=s[1], flags="PA", seq=seq_c + 1, ack=seq_s + 1)
+        / Raw(load=payload),
+        Ether()
+        / IP(src=s[0], dst=c[0])
+        / TCP(
+            sport=s[1],
+            dport=c[1],
+            flags="A",
+            seq=seq_s + 1,
+            ack=seq_c + 1 + len(payload),
+        ),
+    ]
+
+    wrpcap(str(OUT / "smb2-large-declared-length.pcap"), pkts)
+
+
+if __name__ == "__main__":
+    write_pcap(make_payload())